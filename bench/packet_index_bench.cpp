@@ -0,0 +1,134 @@
+// Compares indexing a received response with PacketIndex against parsing it with mdns_records_parse, the way the
+// receive paths read packets before PacketIndex. Both read the owner name of every record and the target of every PTR
+// and SRV record. PacketIndex::build is also measured alone, the part paid once per packet however many stages read it.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "dns_name.hpp"
+#include "legacy_parser.h"
+#include "mdns.h"
+#include "message_builder.hpp"
+#include "packet_index.hpp"
+
+using namespace mdns_cpp;
+
+namespace {
+
+constexpr int iterations = 200000;
+
+// A response of the size a busy network sends: the PTR, SRV, TXT, A and AAAA records of several instances
+std::vector<std::uint8_t> buildResponse() {
+  MessageBuilder message;
+  message.begin(0, 0x8400);
+  PacketWriter &writer = message.writer();
+  const std::string type = wireName("_http._tcp.local.");
+  const std::uint8_t txt[] = {7, 'p', 'a', 't', 'h', '=', '/', 'x'};
+  const std::uint8_t ipv6[16] = {0xfe, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+  for (int iinstance = 0; iinstance < 8; ++iinstance) {
+    const std::string host = "host" + std::to_string(iinstance);
+    writer.addPtr(PacketWriter::Section::Answer, type, MDNS_CLASS_IN, 120, wireName(host + "._http._tcp.local."));
+  }
+  for (int iinstance = 0; iinstance < 8; ++iinstance) {
+    const std::string host = "host" + std::to_string(iinstance);
+    const std::string instance = wireName(host + "._http._tcp.local.");
+    const std::string address = wireName(host + ".local.");
+    const std::uint16_t rclass = MDNS_CLASS_IN | MDNS_CACHE_FLUSH;
+    writer.addSrv(PacketWriter::Section::Additional, instance, rclass, 120, 0, 0, 80, address);
+    writer.addTxt(PacketWriter::Section::Additional, instance, rclass, 120, txt, sizeof(txt));
+    writer.addA(PacketWriter::Section::Additional, address, rclass, 120, 0x0100000a + iinstance);
+    writer.addAaaa(PacketWriter::Section::Additional, address, rclass, 120, ipv6);
+  }
+  return std::vector<std::uint8_t>(message.data(0), message.data(0) + message.size(0));
+}
+
+struct ParseState {
+  char name[256];
+  size_t records;
+};
+
+int parseRecord(int, const struct sockaddr *, size_t, mdns_entry_type_t, uint16_t, uint16_t rtype, uint16_t, uint32_t,
+                const void *data, size_t size, size_t name_offset, size_t, size_t record_offset, size_t record_length,
+                void *user_data) {
+  auto &state = *static_cast<ParseState *>(user_data);
+  mdns_string_extract(data, size, &name_offset, state.name, sizeof(state.name));
+  if (rtype == MDNS_RECORDTYPE_PTR) {
+    mdns_record_parse_ptr(data, size, record_offset, record_length, state.name, sizeof(state.name));
+  } else if (rtype == MDNS_RECORDTYPE_SRV) {
+    mdns_record_parse_srv(data, size, record_offset, record_length, state.name, sizeof(state.name));
+  }
+  ++state.records;
+  return 0;
+}
+
+size_t parseWithRecordsParse(const std::vector<std::uint8_t> &packet, ParseState &state) {
+  const PacketView header(packet.data(), packet.size());
+  size_t offset = PacketView::header_size;
+  for (std::uint16_t iquestion = header.questionCount(); iquestion; --iquestion) {
+    if (!mdns_string_skip(packet.data(), packet.size(), &offset)) {
+      return 0;
+    }
+    offset += 4;
+  }
+  const mdns_entry_type_t sections[3] = {MDNS_ENTRYTYPE_ANSWER, MDNS_ENTRYTYPE_AUTHORITY, MDNS_ENTRYTYPE_ADDITIONAL};
+  const std::uint16_t counts[3] = {header.answerCount(), header.authorityCount(), header.additionalCount()};
+  size_t records = 0;
+  for (int section = 0; section < 3; ++section) {
+    records += mdns_records_parse(0, nullptr, 0, packet.data(), packet.size(), &offset, sections[section], 0,
+                                  counts[section], parseRecord, &state);
+  }
+  return records;
+}
+
+size_t parseWithIndex(const std::vector<std::uint8_t> &packet, PacketIndex &index, std::string &name) {
+  if (!index.build(packet.data(), packet.size())) {
+    return 0;
+  }
+  for (size_t irecord = 0; irecord < index.recordCount(); ++irecord) {
+    const RecordView record = index.record(irecord);
+    record.name().decode(name);
+    SrvView srv;
+    if (record.type() == MDNS_RECORDTYPE_PTR) {
+      record.target().decode(name);
+    } else if (record.type() == MDNS_RECORDTYPE_SRV && record.srv(srv)) {
+      srv.target.decode(name);
+    }
+  }
+  return index.recordCount();
+}
+
+template <typename Parse>
+void run(const char *label, size_t packet_size, Parse &&parse) {
+  using Clock = std::chrono::steady_clock;
+  size_t records = 0;
+  const auto start = Clock::now();
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    records += parse();
+  }
+  const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  std::printf("%-20s %8.1f ns/packet %6.1f ns/record %6.2f GB/s\n", label, elapsed / iterations, elapsed / records,
+              static_cast<double>(packet_size) * iterations / elapsed);
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<std::uint8_t> packet = buildResponse();
+  std::printf("%zu byte response, %d iterations\n", packet.size(), iterations);
+
+  ParseState state{};
+  run("mdns_records_parse", packet.size(), [&]() { return parseWithRecordsParse(packet, state); });
+
+  PacketIndex index;
+  run("PacketIndex::build", packet.size(), [&]() {
+    index.build(packet.data(), packet.size());
+    return index.recordCount();
+  });
+
+  std::string name;
+  run("PacketIndex", packet.size(), [&]() { return parseWithIndex(packet, index, name); });
+  return 0;
+}
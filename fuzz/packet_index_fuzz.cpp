@@ -0,0 +1,47 @@
+// libFuzzer target for the parsing of received packets: indexes the input like a received packet and reads every
+// name and record the index accepted, as the responder and the query thread do.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "dns_name.hpp"
+#include "mdns.h"
+#include "packet_index.hpp"
+#include "record_decoder.hpp"
+
+using namespace mdns_cpp;
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, size_t size) {
+  static PacketIndex index;
+  static std::string name;
+  static FoldedName folded;
+  static QueryRecord record;
+
+  if (!index.build(data, size)) {
+    return 0;
+  }
+  for (size_t iquestion = 0; iquestion < index.questionCount(); ++iquestion) {
+    const QuestionView question = index.question(iquestion);
+    question.name.decode(name);
+    if (question.name.fold(folded)) {
+      question.name.equals(folded);
+    }
+  }
+  for (size_t irecord = 0; irecord < index.recordCount(); ++irecord) {
+    const RecordView view = index.record(irecord);
+    view.name().decode(name);
+    if (view.name().fold(folded)) {
+      view.name().equals(folded);
+    }
+    if (view.type() == MDNS_RECORDTYPE_PTR) {
+      view.target().fold(folded);
+    }
+    SrvView srv;
+    if (view.type() == MDNS_RECORDTYPE_SRV && view.srv(srv)) {
+      srv.target.fold(folded);
+    }
+    decodeRecord(view, record);
+  }
+  return 0;
+}
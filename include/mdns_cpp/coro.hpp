@@ -0,0 +1,245 @@
+#pragma once
+
+// Coroutine interface to the queries of mDNS, available where the compiler supports C++20 coroutines.
+//
+// The awaitables start their query on the query thread of the mDNS object when awaited and resume the coroutine from
+// there once it ended, so thousands of lookups can be in flight as suspended coroutine frames without a thread each.
+// Like the callbacks of startQuery, code running after a co_await runs on the query thread and must not block.
+#ifdef __cpp_impl_coroutine
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mdns_cpp/defs.hpp"
+#include "mdns_cpp/mdns.hpp"
+
+namespace mdns_cpp::coro {
+
+namespace detail {
+
+template <typename T>
+struct TaskResult {
+  std::optional<T> value;
+
+  void return_value(T result) { value.emplace(std::move(result)); }
+  T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+  void return_void() {}
+  void take() {}
+};
+
+// Shared by an awaiter and the callbacks of its query. await_suspend and the done callback both flip arrived, the
+// second one resumes the coroutine, so a query ending before the coroutine suspended does not lose the wakeup.
+template <typename T>
+struct Collector {
+  std::vector<T> items;
+  QueryStatus status{QueryStatus::Completed};
+  std::coroutine_handle<> handle;
+  std::atomic<bool> arrived{false};
+};
+
+}  // namespace detail
+
+// A coroutine returning T, started when awaited or passed to launch(). Awaiting it resumes the awaiter with its result
+// once it finished, or rethrows its exception.
+template <typename T = void>
+class Task {
+ public:
+  struct promise_type : detail::TaskResult<T> {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+          const std::coroutine_handle<> continuation = handle.promise().continuation;
+          return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+    handle_.promise().continuation = awaiter;
+    return handle_;
+  }
+  T await_resume() {
+    if (handle_.promise().exception) {
+      std::rethrow_exception(handle_.promise().exception);
+    }
+    return handle_.promise().take();
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+// A coroutine nobody awaits, its frame is freed when it returns
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+template <typename T>
+Detached run(Task<T> task, std::promise<T> promise) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await task;
+      promise.set_value();
+    } else {
+      promise.set_value(co_await task);
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+}  // namespace detail
+
+// Runs a task on the calling thread until it first suspends and returns a future for its result. The task goes on
+// wherever it is resumed, for the awaitables below the query thread.
+template <typename T>
+std::future<T> launch(Task<T> task) {
+  std::promise<T> promise;
+  std::future<T> future = promise.get_future();
+  detail::run(std::move(task), std::move(promise));
+  return future;
+}
+
+// Awaits the records received by a one-shot query, as collected by mDNS::queryAsync. Awaiting throws
+// std::invalid_argument for an invalid name and std::runtime_error if the query could not be sent.
+class QueryAwaiter {
+ public:
+  QueryAwaiter(mDNS &mdns, std::string name, RecordType type, QueryPolicy policy)
+      : mdns_(mdns), name_(std::move(name)), type_(type), policy_(policy) {}
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  std::vector<QueryRecord> await_resume();
+
+ private:
+  mDNS &mdns_;
+  std::string name_;
+  RecordType type_;
+  QueryPolicy policy_;
+  std::shared_ptr<detail::Collector<QueryRecord>> state_;
+};
+
+// Awaits the instances of a service type resolved by mDNS::resolve. Throws like QueryAwaiter.
+class ResolveAwaiter {
+ public:
+  ResolveAwaiter(mDNS &mdns, std::string service, QueryPolicy policy)
+      : mdns_(mdns), service_(std::move(service)), policy_(policy) {}
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  std::vector<ResolvedService> await_resume();
+
+ private:
+  mDNS &mdns_;
+  std::string service_;
+  QueryPolicy policy_;
+  std::shared_ptr<detail::Collector<ResolvedService>> state_;
+};
+
+inline QueryAwaiter query(mDNS &mdns, std::string name, RecordType type, const QueryPolicy &policy = QueryPolicy()) {
+  return QueryAwaiter(mdns, std::move(name), type, policy);
+}
+
+inline ResolveAwaiter resolve(mDNS &mdns, std::string service, const QueryPolicy &policy = QueryPolicy()) {
+  return ResolveAwaiter(mdns, std::move(service), policy);
+}
+
+struct BrowseUpdate {
+  BrowseEvent event;
+  QueryRecord record;
+};
+
+// The events of an mDNS::browse as a stream: each co_await of next() yields the next one, or std::nullopt once the
+// browse ended. Events arriving while the coroutine is busy are queued. The browse starts with the stream and is
+// cancelled when it is destroyed.
+class BrowseStream {
+ private:
+  struct State {
+    std::mutex mutex;
+    std::deque<BrowseUpdate> updates;
+    bool ended{false};
+    std::coroutine_handle<> waiter;
+  };
+
+ public:
+  class NextAwaiter {
+   public:
+    explicit NextAwaiter(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> handle);
+    std::optional<BrowseUpdate> await_resume();
+
+   private:
+    std::shared_ptr<State> state_;
+  };
+
+  // Throws like mDNS::browse
+  BrowseStream(mDNS &mdns, const std::string &name, RecordType type);
+  ~BrowseStream();
+
+  BrowseStream(const BrowseStream &) = delete;
+  BrowseStream &operator=(const BrowseStream &) = delete;
+
+  NextAwaiter next() { return NextAwaiter(state_); }
+  void cancel() { handle_.cancel(); }
+
+ private:
+  std::shared_ptr<State> state_;
+  QueryHandle handle_;
+};
+
+}  // namespace mdns_cpp::coro
+
+#endif  // __cpp_impl_coroutine
@@ -1,16 +1,158 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace mdns_cpp {
 
-class ServiceRecord {
+// Service data of the single-service responder, which the service registry replaced. Nothing in the library reads it
+// any more, it is only kept so that code naming it still compiles. Describe services with ServiceInstance instead.
+class [[deprecated("Use ServiceInstance and mDNS::addService")]] ServiceRecord {
  public:
   const char *service;
   const char *hostname;
   uint32_t address_ipv4;
   uint8_t *address_ipv6;
   uint16_t port;
+  const char *txt_record;
+  size_t txt_record_length;
 };
 
+using ServiceId = std::uint64_t;
+
+// A service instance advertised as <hostname>.<name> with an SRV record pointing to <hostname>.local. and port, and
+// optional TXT record (a single "key=value" string).
+struct ServiceInstance {
+  std::string name{"_http._tcp.local."};
+  std::string hostname;
+  std::uint16_t port{0};
+  std::string txt_record{};
+};
+
+struct ReceiveStatistics {
+  uint64_t packets{0};
+  uint64_t syscalls{0};
+
+  double packetsPerSyscall() const { return syscalls ? static_cast<double>(packets) / syscalls : 0.0; }
+};
+
+// Record types understood by the query API, with their values on the wire
+enum class RecordType : std::uint16_t { A = 1, PTR = 12, TXT = 16, AAAA = 28, SRV = 33, ANY = 255 };
+
+enum class RecordSection { Answer, Authority, Additional };
+
+// A key=value string of a TXT record, given as positions in QueryRecord::txt
+struct TxtEntry {
+  std::uint16_t key_offset{0};
+  std::uint16_t key_length{0};
+  std::uint16_t value_offset{0};
+  std::uint16_t value_length{0};
+  // False for a key without "=" (a boolean attribute, RFC 6763 section 6.4)
+  bool has_value{false};
+};
+
+// A resource record received in response to a query. Only the fields of its type are set.
+//
+// Records are decoded straight from the packet without any formatting. The query API reuses one object for all records
+// it delivers, so once its strings and vector have grown no record costs an allocation; copy what you keep.
+struct QueryRecord {
+  std::string name;
+  std::uint16_t type{0};
+  std::uint32_t ttl{0};
+  RecordSection section{RecordSection::Answer};
+  // Index of the network interface the record was received on, 0 if unknown
+  unsigned int interface_index{0};
+  // PTR: the instance name, SRV: the host name
+  std::string target;
+  std::uint16_t priority{0};
+  std::uint16_t weight{0};
+  std::uint16_t port{0};
+  // A: address in network byte order
+  std::uint32_t address_ipv4{0};
+  std::uint8_t address_ipv6[16]{0};
+  // TXT: the record data as received, a sequence of length-prefixed strings, and the key=value pairs in it
+  std::string txt;
+  std::vector<TxtEntry> txt_entries;
+
+  std::string_view txtKey(const TxtEntry &entry) const {
+    return std::string_view(txt).substr(entry.key_offset, entry.key_length);
+  }
+  std::string_view txtValue(const TxtEntry &entry) const {
+    return std::string_view(txt).substr(entry.value_offset, entry.value_length);
+  }
+};
+
+// A service instance resolved to what a client connects to: the SRV and TXT records of the instance and the addresses
+// of the host the SRV record points to
+struct ResolvedService {
+  // For example "box._http._tcp.local."
+  std::string instance;
+  std::string host;
+  std::uint16_t port{0};
+  std::uint16_t priority{0};
+  std::uint16_t weight{0};
+  // Empty if the instance sent no TXT record
+  std::string txt;
+  std::vector<TxtEntry> txt_entries;
+  // In network byte order
+  std::vector<std::uint32_t> addresses_ipv4;
+  std::vector<std::array<std::uint8_t, 16>> addresses_ipv6;
+  // Index of the network interface the SRV record was received on, 0 if unknown
+  unsigned int interface_index{0};
+
+  std::string_view txtKey(const TxtEntry &entry) const {
+    return std::string_view(txt).substr(entry.key_offset, entry.key_length);
+  }
+  std::string_view txtValue(const TxtEntry &entry) const {
+    return std::string_view(txt).substr(entry.value_offset, entry.value_length);
+  }
+};
+
+// When a query ends. Limits left at zero do not apply; the first limit reached ends the query, and a query without
+// any limit runs until it is cancelled.
+struct QueryPolicy {
+  // Ends the query this long after it was sent
+  std::chrono::milliseconds timeout{5000};
+  // Ends the query with the response that brings the number of records answering its question to this, 1 ends it with
+  // the first answer. The rest of that response, such as its additional records, is still delivered.
+  std::size_t max_answers{0};
+  // Ends the query once no record arrived for this long, counted from when it was sent
+  std::chrono::milliseconds quiet_period{0};
+  // Uses a quiet period learned from the gaps between the responses to earlier queries of the same mDNS object
+  // instead, smoothed like a TCP retransmission timeout (RFC 6298). quiet_period applies until there is a sample.
+  bool adaptive{false};
+};
+
+// How a query ended
+enum class QueryStatus {
+  // The query ran until its policy ended it
+  Completed,
+  // QueryHandle::cancel() was called or the mDNS object was destroyed
+  Cancelled,
+  // The query could not be sent on any interface
+  Failed,
+};
+
+// What changed in the records seen by a browse
+enum class BrowseEvent {
+  // A record was received for the first time
+  Added,
+  // The data of an SRV or TXT record changed, these hold a single record per name
+  Updated,
+  // A record expired, was withdrawn with a goodbye or replaced by a record with the cache-flush bit
+  Removed,
+};
+
+using QueryId = std::uint64_t;
+using RecordCallback = std::function<void(const QueryRecord &)>;
+using QueryDoneCallback = std::function<void(QueryStatus)>;
+using BrowseCallback = std::function<void(BrowseEvent, const QueryRecord &)>;
+using ResolveCallback = std::function<void(const ResolvedService &)>;
+
 }  // namespace mdns_cpp
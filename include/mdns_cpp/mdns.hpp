@@ -1,17 +1,55 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "mdns_cpp/defs.hpp"
 
 struct sockaddr;
+struct mdns_socket_info_t;
 
 namespace mdns_cpp {
 
+class BatchReceiver;
+class ClientSocketPool;
+class LatencyEstimator;
+class MulticastHistory;
+class QsbrDomain;
+class QueryEngine;
+class Reactor;
+class RecordCache;
+class ServiceChanges;
+class ServiceRegistry;
+
+// Refers to a query started with mDNS::startQuery. Default constructed handles refer to no query.
+class QueryHandle {
+ public:
+  QueryHandle() = default;
+
+  // Ends the query: no further records are delivered and its done callback runs with QueryStatus::Cancelled. Returns
+  // false if the query already ended.
+  bool cancel();
+
+  QueryId id() const { return id_; }
+
+ private:
+  friend class mDNS;
+  QueryHandle(std::weak_ptr<QueryEngine> engine, QueryId id) : engine_(std::move(engine)), id_(id) {}
+
+  std::weak_ptr<QueryEngine> engine_;
+  QueryId id_{0};
+};
+
 class mDNS {
  public:
+  mDNS();
   ~mDNS();
 
   void startService();
@@ -23,20 +61,124 @@ class mDNS {
   void setServiceName(const std::string &name);
   void setServiceTxtRecord(const std::string &text_record);
 
+  // Advertises further service instances next to the one configured with the setService* functions. Instances can be
+  // added, updated and removed while the service is running. A running service announces new and changed instances
+  // twice (RFC 6762 section 8.3) and withdraws the records it no longer advertises with goodbyes (section 10.1).
+  // addService throws std::invalid_argument if the names are not valid domain names, updateService and removeService
+  // return false for unknown ids.
+  ServiceId addService(const ServiceInstance &instance);
+  bool updateService(ServiceId id, const ServiceInstance &instance);
+  bool removeService(ServiceId id);
+  // Id of the instance configured with the setService* functions, 0 once it was removed. updateService replaces it
+  // until the next setService* call, removeService stops advertising it and the setService* functions then have no
+  // effect.
+  ServiceId defaultServiceId() const { return default_service_; }
+
+  // Maximum number of datagrams drained from a socket per wakeup (recvmmsg on Linux). Applies to sockets opened after
+  // the call, 1 disables batching.
+  void setReceiveBatchSize(std::size_t batch_size);
+  ReceiveStatistics getReceiveStatistics() const;
+
+  // Largest UDP payload sent (default 1452 bytes, at least 512). Queries, known-answer lists and multicast answers that
+  // do not fit are split into several packets. Applies from the next startService and to the query thread if it is
+  // started after the call.
+  void setMaxPacketSize(std::size_t bytes);
+
+  // Number of threads answering queries, each with its own sockets bound with SO_REUSEPORT and pinned to a core of its
+  // own. Every worker receives each multicast query and the source address picks the one that answers it. Applies
+  // from the next startService, only Linux supports more than one worker.
+  void setServiceWorkers(std::size_t workers);
+
+  // Query the service type (PTR records) or the DNS-SD service types on every interface and block until no response
+  // arrived for 5 seconds, or until policy ends the query. The received records are logged, or passed to on_record on
+  // the calling thread. If the record cache holds fresh answers they are passed on at once instead, without a query.
+  // Throws std::invalid_argument if policy sets neither a timeout, a number of answers nor a quiet period.
   void executeQuery(const std::string &service);
+  void executeQuery(const std::string &service, const RecordCallback &on_record);
+  void executeQuery(const std::string &service, const RecordCallback &on_record, const QueryPolicy &policy);
   void executeDiscovery();
+  void executeDiscovery(const RecordCallback &on_record);
+
+  // Sends a query for the records of the given type named name and returns at once. on_record runs for every record
+  // received in response until the timeout passes, then on_done runs once with the reason the query ended. Callbacks
+  // run on a query thread shared by all queries of this object and must not block. A query the record cache holds fresh
+  // answers for gets them and completes at once. Throws std::invalid_argument if name is not a valid domain name and
+  // std::runtime_error if no client socket could be opened.
+  QueryHandle startQuery(const std::string &name, RecordType type, RecordCallback on_record,
+                         QueryDoneCallback on_done = {},
+                         std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+  // Like startQuery, ending the query as policy says, for example with its first answer or once no record arrived for
+  // a while
+  QueryHandle startQuery(const std::string &name, RecordType type, RecordCallback on_record, QueryDoneCallback on_done,
+                         const QueryPolicy &policy);
+  // Like startQuery, collecting the records received until the query ends. The future holds a std::runtime_error if
+  // the query could not be sent.
+  std::future<std::vector<QueryRecord>> queryAsync(const std::string &name, RecordType type,
+                                                   std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+  std::future<std::vector<QueryRecord>> queryAsync(const std::string &name, RecordType type,
+                                                   const QueryPolicy &policy);
+
+  // Resolves the instances of a service type such as "_http._tcp.local." to host, port, TXT record and addresses.
+  // Every record of every response is used, including the SRV, TXT and address records responders add to their PTR
+  // answers, so an instance usually resolves with the first response; only the pieces still missing when the policy
+  // ends the PTR query are queried for, in up to two more rounds under the same policy. on_resolved runs once per
+  // instance as soon as it is complete, on_done once the last round ended. Throws like startQuery.
+  QueryHandle resolve(const std::string &service, ResolveCallback on_resolved, QueryDoneCallback on_done = {},
+                      const QueryPolicy &policy = QueryPolicy());
+  // Like resolve, collecting the resolved instances
+  std::future<std::vector<ResolvedService>> resolveAsync(const std::string &service,
+                                                         const QueryPolicy &policy = QueryPolicy());
+
+  // Keeps a live view of the records of the given type named name, for example the instances of "_http._tcp.local.".
+  // on_event reports each record as it is added, updated and removed until the browse is cancelled, then on_done runs
+  // with QueryStatus::Cancelled. Queries are sent again after 1, 2, 4... seconds up to an hour, and the reported
+  // records are refreshed at 80-95% of their TTL (RFC 6762 section 5.2), so a steady browse sends next to nothing.
+  // Throws like startQuery.
+  QueryHandle browse(const std::string &name, RecordType type, BrowseCallback on_event,
+                     QueryDoneCallback on_done = {});
+
+  // Every record received by a query is cached for its TTL (4096 records by default). A full cache, or one shrunk
+  // below its size, evicts the records closest to expiry. A capacity of 0 disables the cache.
+  void setRecordCacheCapacity(std::size_t capacity);
+  void clearRecordCache();
 
  private:
-  void runMainLoop();
-  int openClientSockets(int *sockets, int max_sockets, int port);
-  int openServiceSockets(int *sockets, int max_sockets);
+  void runMainLoop(std::size_t worker);
+  int openClientSockets(mdns_socket_info_t *sockets, int max_sockets, int port);
+  int openServiceSockets(mdns_socket_info_t *sockets, int max_sockets);
+  std::size_t receive(BatchReceiver &receiver, int sock);
+  ServiceInstance defaultServiceInstance() const;
+  void updateDefaultService();
+  // Replaces the instance id in registry, or removes it if instance is nullptr, and stages goodbyes for its records
+  bool changeService(ServiceRegistry &registry, ServiceId id, const ServiceInstance *instance);
+  template <typename Fn>
+  bool updateRegistry(Fn &&fn);
+  // Starts the query thread and its sockets on first use
+  std::shared_ptr<QueryEngine> queryEngine();
+  // Opens or refreshes the sockets of the blocking queries and drops stale datagrams, client_mutex_ must be held
+  ClientSocketPool &clientSockets(BatchReceiver &receiver);
 
   std::string hostname_{"dummy-host"};
   std::string name_{"_http._tcp.local."};
   std::uint16_t port_{42424};
   std::string txt_record_{};
 
-  bool running_{false};
+  // Current version of the registry, replaced as a whole on every change. The service workers read it without locks.
+  std::atomic<const ServiceRegistry *> registry_{nullptr};
+  // Serializes the writers of registry_
+  std::mutex registry_mutex_;
+  // Tells when the service workers no longer use a replaced registry
+  std::unique_ptr<QsbrDomain> registry_readers_;
+  std::atomic<ServiceId> default_service_{0};
+  // Announcements and goodbyes for the service workers to send, staged under registry_mutex_
+  std::unique_ptr<ServiceChanges> service_changes_;
+
+  std::atomic<bool> running_{false};
+
+  std::size_t receive_batch_size_{16};
+  std::size_t max_packet_size_{1452};
+  std::atomic<std::uint64_t> received_packets_{0};
+  std::atomic<std::uint64_t> receive_syscalls_{0};
 
   bool has_ipv4_{false};
   bool has_ipv6_{false};
@@ -44,7 +186,19 @@ class mDNS {
   uint32_t service_address_ipv4_{0};
   uint8_t service_address_ipv6_[16]{0};
 
-  std::thread worker_thread_;
+  std::size_t service_workers_{1};
+  std::unique_ptr<MulticastHistory> multicast_history_;
+  std::vector<std::unique_ptr<Reactor>> reactors_;
+  std::vector<std::thread> worker_threads_;
+
+  std::shared_ptr<RecordCache> record_cache_;
+  // Gaps between query responses, for adaptive quiet periods
+  std::shared_ptr<LatencyEstimator> query_latency_;
+  std::mutex query_mutex_;
+  std::shared_ptr<QueryEngine> query_engine_;
+  // Serializes executeQuery and executeDiscovery, which share their sockets
+  std::mutex client_mutex_;
+  std::unique_ptr<ClientSocketPool> client_sockets_;
 };
 
 }  // namespace mdns_cpp
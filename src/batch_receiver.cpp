@@ -0,0 +1,98 @@
+#include "batch_receiver.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace mdns_cpp {
+
+BatchReceiver::BatchReceiver(size_t batch_size)
+    : batch_size_(std::max<size_t>(batch_size, 1)),
+      buffers_(batch_size_ * packet_capacity),
+      addresses_(batch_size_),
+      sizes_(batch_size_),
+      addrlens_(batch_size_),
+      multicast_(batch_size_, true) {
+#ifdef __linux__
+  iovecs_.resize(batch_size_);
+  messages_.resize(batch_size_);
+  controls_.resize(batch_size_ * control_capacity);
+  for (size_t i = 0; i < batch_size_; ++i) {
+    iovecs_[i].iov_base = buffers_.data() + i * packet_capacity;
+    iovecs_[i].iov_len = packet_capacity;
+    memset(&messages_[i], 0, sizeof(mmsghdr));
+    messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+    messages_[i].msg_hdr.msg_iovlen = 1;
+    messages_[i].msg_hdr.msg_name = &addresses_[i];
+  }
+#endif
+}
+
+void BatchReceiver::requestDestination(int sock, int family) {
+#ifdef __linux__
+  const int enable = 1;
+  if (family == AF_INET6) {
+    setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &enable, sizeof(enable));
+  } else {
+    setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &enable, sizeof(enable));
+  }
+#else
+  (void)sizeof(sock);
+  (void)sizeof(family);
+#endif
+}
+
+size_t BatchReceiver::receive(int sock) {
+  size_t received = 0;
+
+#ifdef __linux__
+  for (size_t i = 0; i < batch_size_; ++i) {
+    messages_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    messages_[i].msg_hdr.msg_control = controls_.data() + i * control_capacity;
+    messages_[i].msg_hdr.msg_controllen = control_capacity;
+  }
+  ++syscalls_;
+  const int ret = recvmmsg(sock, messages_.data(), static_cast<unsigned int>(batch_size_), MSG_DONTWAIT, nullptr);
+  if (ret > 0) {
+    for (int i = 0; i < ret; ++i) {
+      sizes_[received] = messages_[i].msg_len;
+      addrlens_[received] = messages_[i].msg_hdr.msg_namelen;
+      multicast_[received] = true;
+      msghdr &header = messages_[i].msg_hdr;
+      for (cmsghdr *control = CMSG_FIRSTHDR(&header); control; control = CMSG_NXTHDR(&header, control)) {
+        if (control->cmsg_level == IPPROTO_IP && control->cmsg_type == IP_PKTINFO) {
+          const auto *info = reinterpret_cast<const in_pktinfo *>(CMSG_DATA(control));
+          multicast_[received] = IN_MULTICAST(ntohl(info->ipi_addr.s_addr));
+        } else if (control->cmsg_level == IPPROTO_IPV6 && control->cmsg_type == IPV6_PKTINFO) {
+          const auto *info = reinterpret_cast<const in6_pktinfo *>(CMSG_DATA(control));
+          multicast_[received] = IN6_IS_ADDR_MULTICAST(&info->ipi6_addr);
+        }
+      }
+      ++received;
+    }
+  }
+#else
+  while (received < batch_size_) {
+    auto *addr = reinterpret_cast<sockaddr *>(&addresses_[received]);
+    socklen_t addrlen = sizeof(sockaddr_storage);
+    memset(addr, 0, sizeof(sockaddr_storage));
+#ifdef __APPLE__
+    addr->sa_len = sizeof(sockaddr_storage);
+#endif
+    ++syscalls_;
+    const int ret = recvfrom(sock, (char *)(buffers_.data() + received * packet_capacity), (int)packet_capacity, 0,
+                             addr, &addrlen);
+    if (ret <= 0) {
+      break;
+    }
+    sizes_[received] = static_cast<size_t>(ret);
+    addrlens_[received] = addrlen;
+    ++received;
+  }
+#endif
+
+  packets_ += received;
+  return received;
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+namespace mdns_cpp {
+
+// Drains several datagrams from a socket per wakeup into a ring of pre-allocated buffers.
+//
+// On Linux a single recvmmsg() call fills the whole batch, elsewhere the non-blocking socket is read with recvfrom()
+// until it would block or the batch is full. The number of packets and system calls is counted so callers can report
+// how many packets each syscall delivered.
+//
+// Sockets prepared with requestDestination() also report whether each datagram was sent to a multicast group. This is
+// only supported on Linux, elsewhere every datagram is reported as multicast.
+class BatchReceiver {
+ public:
+  static constexpr size_t packet_capacity = 2048;
+
+  explicit BatchReceiver(size_t batch_size);
+
+  // Asks the kernel to pass the destination address of datagrams received on a socket of the given address family
+  // (IP_PKTINFO / IPV6_RECVPKTINFO)
+  static void requestDestination(int sock, int family);
+
+  BatchReceiver(const BatchReceiver &) = delete;
+  BatchReceiver &operator=(const BatchReceiver &) = delete;
+
+  // Receives up to batchSize() datagrams from sock. Returns the number of datagrams now held by the receiver, which
+  // stay valid until the next call.
+  size_t receive(int sock);
+
+  size_t batchSize() const { return batch_size_; }
+
+  const void *data(size_t index) const { return buffers_.data() + index * packet_capacity; }
+  size_t size(size_t index) const { return sizes_[index]; }
+  const sockaddr *from(size_t index) const { return reinterpret_cast<const sockaddr *>(&addresses_[index]); }
+  size_t addrlen(size_t index) const { return addrlens_[index]; }
+  bool multicast(size_t index) const { return multicast_[index]; }
+
+  std::uint64_t packets() const { return packets_; }
+  std::uint64_t syscalls() const { return syscalls_; }
+
+ private:
+  size_t batch_size_;
+  std::vector<std::uint8_t> buffers_;
+  std::vector<sockaddr_storage> addresses_;
+  std::vector<size_t> sizes_;
+  std::vector<size_t> addrlens_;
+  std::vector<bool> multicast_;
+#ifdef __linux__
+  static constexpr size_t control_capacity = CMSG_SPACE(sizeof(in6_pktinfo));
+
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> messages_;
+  std::vector<std::uint8_t> controls_;
+#endif
+
+  std::uint64_t packets_{0};
+  std::uint64_t syscalls_{0};
+};
+
+}  // namespace mdns_cpp
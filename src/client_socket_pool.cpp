@@ -0,0 +1,301 @@
+#include "client_socket_pool.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <iphlpapi.h>
+#else
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+#ifdef __APPLE__
+#include <fcntl.h>
+#include <net/route.h>
+#endif
+
+#include "mdns_cpp/macros.hpp"
+
+namespace mdns_cpp {
+
+namespace {
+
+void addAddress(std::vector<InterfaceAddress> &addresses, unsigned int interface_index, const sockaddr *address,
+                socklen_t address_length) {
+  InterfaceAddress local;
+  local.interface_index = interface_index;
+  memcpy(&local.address, address, address_length);
+  local.address_length = address_length;
+  if (address->sa_family == AF_INET6) {
+    reinterpret_cast<sockaddr_in6 *>(&local.address)->sin6_port = 0;
+  } else {
+    reinterpret_cast<sockaddr_in *>(&local.address)->sin_port = 0;
+  }
+  addresses.push_back(local);
+}
+
+// The address of the interface an IPv4 socket opened by openInterfaceSocket multicasts on
+bool multicastAddress(const mdns_socket_info_t &socket, in_addr &address) {
+  socklen_t length = sizeof(address);
+  return !getsockopt(socket.sock, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast<char *>(&address), &length);
+}
+
+}  // namespace
+
+bool operator==(const InterfaceAddress &lhs, const InterfaceAddress &rhs) {
+  if (lhs.interface_index != rhs.interface_index || lhs.address.ss_family != rhs.address.ss_family) {
+    return false;
+  }
+  if (lhs.address.ss_family == AF_INET6) {
+    return !memcmp(&reinterpret_cast<const sockaddr_in6 *>(&lhs.address)->sin6_addr,
+                   &reinterpret_cast<const sockaddr_in6 *>(&rhs.address)->sin6_addr, sizeof(in6_addr));
+  }
+  return reinterpret_cast<const sockaddr_in *>(&lhs.address)->sin_addr.s_addr ==
+         reinterpret_cast<const sockaddr_in *>(&rhs.address)->sin_addr.s_addr;
+}
+
+std::vector<InterfaceAddress> listInterfaceAddresses() {
+  std::vector<InterfaceAddress> addresses;
+
+#ifdef _WIN32
+
+  IP_ADAPTER_ADDRESSES *adapter_address = nullptr;
+  ULONG address_size = 8000;
+  unsigned int ret{};
+  unsigned int num_retries = 4;
+  do {
+    adapter_address = (IP_ADAPTER_ADDRESSES *)malloc(address_size);
+    ret = GetAdaptersAddresses(AF_UNSPEC, GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_ANYCAST, 0, adapter_address,
+                               &address_size);
+    if (ret == ERROR_BUFFER_OVERFLOW) {
+      free(adapter_address);
+      adapter_address = 0;
+    } else {
+      break;
+    }
+  } while (num_retries-- > 0);
+
+  if (!adapter_address || (ret != NO_ERROR)) {
+    free(adapter_address);
+    MDNS_LOG << "Failed to get network adapter addresses\n";
+    return addresses;
+  }
+
+  for (PIP_ADAPTER_ADDRESSES adapter = adapter_address; adapter; adapter = adapter->Next) {
+    if (adapter->TunnelType == TUNNEL_TYPE_TEREDO) {
+      continue;
+    }
+    if (adapter->OperStatus != IfOperStatusUp) {
+      continue;
+    }
+
+    for (IP_ADAPTER_UNICAST_ADDRESS *unicast = adapter->FirstUnicastAddress; unicast; unicast = unicast->Next) {
+      if (unicast->Address.lpSockaddr->sa_family == AF_INET) {
+        struct sockaddr_in *saddr = (struct sockaddr_in *)unicast->Address.lpSockaddr;
+        if ((saddr->sin_addr.S_un.S_un_b.s_b1 != 127) || (saddr->sin_addr.S_un.S_un_b.s_b2 != 0) ||
+            (saddr->sin_addr.S_un.S_un_b.s_b3 != 0) || (saddr->sin_addr.S_un.S_un_b.s_b4 != 1)) {
+          addAddress(addresses, adapter->IfIndex, unicast->Address.lpSockaddr, sizeof(struct sockaddr_in));
+        }
+      } else if (unicast->Address.lpSockaddr->sa_family == AF_INET6) {
+        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)unicast->Address.lpSockaddr;
+        static constexpr unsigned char localhost[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+        static constexpr unsigned char localhost_mapped[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x7f, 0, 0, 1};
+        if ((unicast->DadState == NldsPreferred) && memcmp(saddr->sin6_addr.s6_addr, localhost, 16) &&
+            memcmp(saddr->sin6_addr.s6_addr, localhost_mapped, 16)) {
+          addAddress(addresses, adapter->Ipv6IfIndex, unicast->Address.lpSockaddr, sizeof(struct sockaddr_in6));
+        }
+      }
+    }
+  }
+
+  free(adapter_address);
+
+#else
+
+  struct ifaddrs *ifaddr = nullptr;
+  struct ifaddrs *ifa = nullptr;
+
+  if (getifaddrs(&ifaddr) < 0) {
+    MDNS_LOG << "Unable to get interface addresses\n";
+    return addresses;
+  }
+
+  for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+    if (!ifa->ifa_addr) {
+      continue;
+    }
+
+    if (ifa->ifa_addr->sa_family == AF_INET) {
+      struct sockaddr_in *saddr = (struct sockaddr_in *)ifa->ifa_addr;
+      if (saddr->sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
+        addAddress(addresses, if_nametoindex(ifa->ifa_name), ifa->ifa_addr, sizeof(struct sockaddr_in));
+      }
+    } else if (ifa->ifa_addr->sa_family == AF_INET6) {
+      struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)ifa->ifa_addr;
+      static constexpr unsigned char localhost[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+      static constexpr unsigned char localhost_mapped[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x7f, 0, 0, 1};
+      if (memcmp(saddr->sin6_addr.s6_addr, localhost, 16) && memcmp(saddr->sin6_addr.s6_addr, localhost_mapped, 16)) {
+        addAddress(addresses, if_nametoindex(ifa->ifa_name), ifa->ifa_addr, sizeof(struct sockaddr_in6));
+      }
+    }
+  }
+
+  freeifaddrs(ifaddr);
+
+#endif
+
+  return addresses;
+}
+
+int openInterfaceSocket(const InterfaceAddress &local, int port, mdns_socket_info_t &info) {
+  InterfaceAddress bind_address = local;
+  int sock = -1;
+  if (local.address.ss_family == AF_INET6) {
+    auto *saddr = reinterpret_cast<sockaddr_in6 *>(&bind_address.address);
+    saddr->sin6_port = htons((unsigned short)port);
+    sock = mdns_socket_open_ipv6(saddr);
+  } else {
+    auto *saddr = reinterpret_cast<sockaddr_in *>(&bind_address.address);
+    saddr->sin_port = htons((unsigned short)port);
+    sock = mdns_socket_open_ipv4(saddr);
+  }
+  if (sock >= 0 && mdns_socket_describe(sock, local.interface_index, &info) < 0) {
+    mdns_socket_close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+bool joinInterface(const mdns_socket_info_t &socket, const mdns_socket_info_t &interface_socket) {
+  if (socket.family != interface_socket.family) {
+    return false;
+  }
+  int result = 0;
+  if (socket.family == AF_INET6) {
+    ipv6_mreq req{};
+    req.ipv6mr_multiaddr = reinterpret_cast<const sockaddr_in6 *>(&socket.multicast_addr)->sin6_addr;
+    req.ipv6mr_interface = interface_socket.interface_index;
+    result = setsockopt(socket.sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, reinterpret_cast<const char *>(&req), sizeof(req));
+  } else {
+    ip_mreq req{};
+    req.imr_multiaddr = reinterpret_cast<const sockaddr_in *>(&socket.multicast_addr)->sin_addr;
+    if (!multicastAddress(interface_socket, req.imr_interface)) {
+      return false;
+    }
+    result = setsockopt(socket.sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char *>(&req), sizeof(req));
+  }
+  // Joining an interface twice fails, the socket receives from it all the same
+  return !result || errno == EADDRINUSE;
+}
+
+bool sendOnInterface(const mdns_socket_info_t &socket, const mdns_socket_info_t &interface_socket) {
+  if (socket.family != interface_socket.family) {
+    return false;
+  }
+  if (socket.family == AF_INET6) {
+    const unsigned int ifindex = interface_socket.interface_index;
+    return !setsockopt(socket.sock, IPPROTO_IPV6, IPV6_MULTICAST_IF, reinterpret_cast<const char *>(&ifindex),
+                       sizeof(ifindex));
+  }
+  in_addr address{};
+  return multicastAddress(interface_socket, address) &&
+         !setsockopt(socket.sock, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast<const char *>(&address),
+                     sizeof(address));
+}
+
+ClientSocketPool::ClientSocketPool() {
+#ifdef __linux__
+  change_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (change_fd_ >= 0) {
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(change_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+      close(change_fd_);
+      change_fd_ = -1;
+    }
+  }
+#elif defined(__APPLE__)
+  change_fd_ = socket(PF_ROUTE, SOCK_RAW, AF_UNSPEC);
+  if (change_fd_ >= 0) {
+    fcntl(change_fd_, F_SETFL, fcntl(change_fd_, F_GETFL, 0) | O_NONBLOCK);
+  }
+#endif
+  if (change_fd_ < 0) {
+#ifndef _WIN32
+    MDNS_LOG << "Interface changes are not reported, rescanning interfaces periodically: " << strerror(errno) << "\n";
+#endif
+  }
+}
+
+ClientSocketPool::~ClientSocketPool() {
+  for (const mdns_socket_info_t &socket : sockets_) {
+    mdns_socket_close(socket.sock);
+  }
+#ifndef _WIN32
+  if (change_fd_ >= 0) {
+    close(change_fd_);
+  }
+#endif
+}
+
+bool ClientSocketPool::mayHaveChanged(Clock::time_point now) {
+  if (change_fd_ < 0) {
+    return now - last_listed_ >= rescan_interval;
+  }
+
+  bool changed = false;
+#ifndef _WIN32
+  char buffer[4096];
+  while (recv(change_fd_, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    changed = true;
+  }
+#endif
+  return changed;
+}
+
+bool ClientSocketPool::refresh(bool force) {
+  const auto now = Clock::now();
+  if (!mayHaveChanged(now) && listed_ && !force) {
+    return false;
+  }
+  listed_ = true;
+  last_listed_ = now;
+
+  const std::vector<InterfaceAddress> addresses = listInterfaceAddresses();
+  bool changed = false;
+
+  for (size_t i = 0; i < addresses_.size();) {
+    if (std::find(addresses.begin(), addresses.end(), addresses_[i]) == addresses.end()) {
+      mdns_socket_close(sockets_[i].sock);
+      addresses_.erase(addresses_.begin() + i);
+      sockets_.erase(sockets_.begin() + i);
+      changed = true;
+    } else {
+      ++i;
+    }
+  }
+
+  for (const InterfaceAddress &local : addresses) {
+    if (std::find(addresses_.begin(), addresses_.end(), local) != addresses_.end()) {
+      continue;
+    }
+    mdns_socket_info_t info;
+    if (openInterfaceSocket(local, 0, info) >= 0) {
+      addresses_.push_back(local);
+      sockets_.push_back(info);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+// A unicast address of a local network interface that mDNS queries can be sent from
+struct InterfaceAddress {
+  unsigned int interface_index{0};
+  // Port 0
+  sockaddr_storage address{};
+  socklen_t address_length{0};
+};
+
+// True if both refer to the same address of the same interface
+bool operator==(const InterfaceAddress &lhs, const InterfaceAddress &rhs);
+
+// Lists the addresses of the local interfaces except loopback addresses. On Windows only adapters that are up are
+// listed, without Teredo tunnels and IPv6 addresses that are not preferred yet.
+std::vector<InterfaceAddress> listInterfaceAddresses();
+
+// Opens a socket for sending mDNS queries from a local address and describes it, returns the socket or <0 if error
+int openInterfaceSocket(const InterfaceAddress &local, int port, mdns_socket_info_t &info);
+
+// Make a socket bound to the mDNS port for all interfaces receive the mDNS multicasts arriving on the interface of a
+// socket opened by openInterfaceSocket, or send its multicasts there. Return false if error.
+bool joinInterface(const mdns_socket_info_t &socket, const mdns_socket_info_t &interface_socket);
+bool sendOnInterface(const mdns_socket_info_t &socket, const mdns_socket_info_t &interface_socket);
+
+// One client socket per local interface address, kept open across queries.
+//
+// The sockets only change when the interfaces do. On Linux a netlink socket and on macOS a routing socket report
+// address and link changes; elsewhere the interfaces are listed again after rescan_interval. Sockets of addresses that
+// are still present are never reopened.
+//
+// The pool is not synchronized.
+class ClientSocketPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // How often the interfaces are listed again where the system does not report changes
+  static constexpr std::chrono::seconds rescan_interval{30};
+
+  ClientSocketPool();
+  ~ClientSocketPool();
+
+  ClientSocketPool(const ClientSocketPool &) = delete;
+  ClientSocketPool &operator=(const ClientSocketPool &) = delete;
+
+  // Lists the interfaces again if they may have changed since the last call (always if force), then opens a socket for
+  // each new address and closes the sockets of addresses that are gone. Returns true if any socket was opened or
+  // closed.
+  bool refresh(bool force = false);
+
+  const std::vector<mdns_socket_info_t> &sockets() const { return sockets_; }
+
+  // Becomes readable when the interfaces change, -1 where changes are not reported
+  int changeDescriptor() const { return change_fd_; }
+
+ private:
+  // Consumes the pending change notifications
+  bool mayHaveChanged(Clock::time_point now);
+
+  int change_fd_{-1};
+  bool listed_{false};
+  Clock::time_point last_listed_{};
+  // The address of each socket in sockets_
+  std::vector<InterfaceAddress> addresses_;
+  std::vector<mdns_socket_info_t> sockets_;
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,113 @@
+#include "mdns_cpp/coro.hpp"
+
+#ifdef __cpp_impl_coroutine
+
+#include <stdexcept>
+
+namespace mdns_cpp::coro {
+
+namespace {
+
+// Ends the wait of an awaiter, resuming its coroutine unless await_suspend did not get to suspend it yet
+template <typename T>
+void arrive(detail::Collector<T> &state) {
+  if (state.arrived.exchange(true)) {
+    state.handle.resume();
+  }
+}
+
+template <typename T>
+std::vector<T> collected(detail::Collector<T> &state) {
+  if (state.status == QueryStatus::Failed) {
+    throw std::runtime_error("Failed to send mDNS query");
+  }
+  return std::move(state.items);
+}
+
+}  // namespace
+
+bool QueryAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  state_ = std::make_shared<detail::Collector<QueryRecord>>();
+  state_->handle = handle;
+  auto state = state_;
+  mdns_.startQuery(
+      name_, type_, [state](const QueryRecord &record) { state->items.push_back(record); },
+      [state](QueryStatus status) {
+        state->status = status;
+        arrive(*state);
+      },
+      policy_);
+  // Stays suspended unless the query already ended
+  return !state->arrived.exchange(true);
+}
+
+std::vector<QueryRecord> QueryAwaiter::await_resume() { return collected(*state_); }
+
+bool ResolveAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  state_ = std::make_shared<detail::Collector<ResolvedService>>();
+  state_->handle = handle;
+  auto state = state_;
+  mdns_.resolve(
+      service_, [state](const ResolvedService &service) { state->items.push_back(service); },
+      [state](QueryStatus status) {
+        state->status = status;
+        arrive(*state);
+      },
+      policy_);
+  return !state->arrived.exchange(true);
+}
+
+std::vector<ResolvedService> ResolveAwaiter::await_resume() { return collected(*state_); }
+
+BrowseStream::BrowseStream(mDNS &mdns, const std::string &name, RecordType type) : state_(std::make_shared<State>()) {
+  const auto wake = [](State &state, std::unique_lock<std::mutex> &lock) {
+    const std::coroutine_handle<> waiter = std::exchange(state.waiter, {});
+    lock.unlock();
+    if (waiter) {
+      waiter.resume();
+    }
+  };
+  auto state = state_;
+  handle_ = mdns.browse(
+      name, type,
+      [state, wake](BrowseEvent event, const QueryRecord &record) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->updates.push_back(BrowseUpdate{event, record});
+        wake(*state, lock);
+      },
+      [state, wake](QueryStatus) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->ended = true;
+        wake(*state, lock);
+      });
+}
+
+BrowseStream::~BrowseStream() { handle_.cancel(); }
+
+bool BrowseStream::NextAwaiter::await_ready() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return !state_->updates.empty() || state_->ended;
+}
+
+bool BrowseStream::NextAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (!state_->updates.empty() || state_->ended) {
+    return false;
+  }
+  state_->waiter = handle;
+  return true;
+}
+
+std::optional<BrowseUpdate> BrowseStream::NextAwaiter::await_resume() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (state_->updates.empty()) {
+    return std::nullopt;
+  }
+  BrowseUpdate update = std::move(state_->updates.front());
+  state_->updates.pop_front();
+  return update;
+}
+
+}  // namespace mdns_cpp::coro
+
+#endif  // __cpp_impl_coroutine
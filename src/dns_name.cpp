@@ -0,0 +1,220 @@
+#include "dns_name.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MDNS_CPP_SSE2 1
+#endif
+
+namespace mdns_cpp {
+
+namespace {
+
+constexpr size_t max_label_length = 63;
+// Every compression pointer has to point to an earlier label, so a name can never contain more jumps than labels
+constexpr int max_pointer_jumps = 128;
+
+inline std::uint8_t foldChar(std::uint8_t c) { return (c >= 'A' && c <= 'Z') ? static_cast<std::uint8_t>(c + 32) : c; }
+
+// The vector folds add 0x80 - 'A' to every byte, which maps 'A'..'Z' to the 26 smallest signed values and everything
+// else above them, so a single signed compare finds the upper case letters
+constexpr char fold_bias = static_cast<char>(0x80 - 'A');
+constexpr char fold_limit = -128 + ('Z' - 'A' + 1);
+
+#ifdef MDNS_CPP_SSE2
+inline __m128i fold16(__m128i bytes) {
+  const __m128i upper = _mm_cmplt_epi8(_mm_add_epi8(bytes, _mm_set1_epi8(fold_bias)), _mm_set1_epi8(fold_limit));
+  return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+#ifdef __AVX2__
+inline __m256i fold32(__m256i bytes) {
+  const __m256i biased = _mm256_add_epi8(bytes, _mm256_set1_epi8(fold_bias));
+  const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(fold_limit), biased);
+  return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+constexpr size_t fold_chunk = 32;
+#elif defined(MDNS_CPP_SSE2)
+constexpr size_t fold_chunk = 16;
+#else
+constexpr size_t fold_chunk = 8;
+#endif
+
+inline std::uint64_t loadWord(const std::uint8_t *data) {
+  std::uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+inline std::uint64_t hashWord(std::uint64_t hash, std::uint64_t word) {
+  hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+  return hash ^ (hash >> 32);
+}
+
+// The finalizer of MurmurHash3, so the low bits depend on every input bit
+inline std::uint64_t finishHash(std::uint64_t hash, size_t length) {
+  hash ^= length;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  return hash ^ (hash >> 33);
+}
+
+// Folds name.data in place and hashes it in the same pass, a chunk at a time. name.data is large enough for the
+// last chunk to run past length, the last word is zero padded there as hashFoldedName pads it.
+void foldAndHash(FoldedName &name) {
+  static_assert(sizeof(name.data) % fold_chunk == 0, "the chunks must not run past the name buffer");
+  std::uint8_t *data = name.data;
+  std::memset(data + name.length, 0, (8 - name.length % 8) % 8);
+  std::uint64_t hash = 0;
+  for (size_t chunk = 0; chunk < name.length; chunk += fold_chunk) {
+#ifdef __AVX2__
+    auto *bytes = reinterpret_cast<__m256i *>(data + chunk);
+    _mm256_storeu_si256(bytes, fold32(_mm256_loadu_si256(bytes)));
+#elif defined(MDNS_CPP_SSE2)
+    auto *bytes = reinterpret_cast<__m128i *>(data + chunk);
+    _mm_storeu_si128(bytes, fold16(_mm_loadu_si128(bytes)));
+#else
+    for (size_t i = chunk; i < chunk + fold_chunk; ++i) {
+      data[i] = foldChar(data[i]);
+    }
+#endif
+    for (size_t word = chunk; word < chunk + fold_chunk && word < name.length; word += 8) {
+      hash = hashWord(hash, loadWord(data + word));
+    }
+  }
+  name.hash = finishHash(hash, name.length);
+}
+
+}  // namespace
+
+std::uint64_t hashFoldedName(const std::uint8_t *data, size_t length) {
+  std::uint64_t hash = 0;
+  size_t word = 0;
+  for (; word + 8 <= length; word += 8) {
+    hash = hashWord(hash, loadWord(data + word));
+  }
+  if (word < length) {
+    std::uint8_t last[8] = {0};
+    std::memcpy(last, data + word, length - word);
+    hash = hashWord(hash, loadWord(last));
+  }
+  return finishHash(hash, length);
+}
+
+bool foldedEquals(const std::uint8_t *raw, const std::uint8_t *folded, size_t length) {
+  size_t i = 0;
+#ifdef __AVX2__
+  for (; i + 32 <= length; i += 32) {
+    const __m256i lhs = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(raw + i)));
+    const __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(folded + i));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(lhs, rhs)) != -1) {
+      return false;
+    }
+  }
+#endif
+#ifdef MDNS_CPP_SSE2
+  for (; i + 16 <= length; i += 16) {
+    const __m128i lhs = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i)));
+    const __m128i rhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(folded + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs)) != 0xFFFF) {
+      return false;
+    }
+  }
+  if (i < length && length >= 16) {
+    // The last bytes as a chunk overlapping the one before
+    i = length - 16;
+    const __m128i lhs = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i)));
+    const __m128i rhs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(folded + i));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs)) == 0xFFFF;
+  }
+#endif
+  for (; i < length; ++i) {
+    if (foldChar(raw[i]) != folded[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool foldName(const void *buffer, size_t size, size_t offset, FoldedName &name) {
+  const auto *bytes = static_cast<const std::uint8_t *>(buffer);
+  size_t length = 0;
+  int jumps = 0;
+
+  while (offset < size) {
+    const std::uint8_t label_length = bytes[offset];
+    if ((label_length & 0xC0) == 0xC0) {
+      if (offset + 2 > size || ++jumps > max_pointer_jumps) {
+        return false;
+      }
+      offset = ((label_length & 0x3F) << 8) | bytes[offset + 1];
+      continue;
+    }
+    if (!label_length) {
+      name.data[length++] = 0;
+      name.length = length;
+      foldAndHash(name);
+      return true;
+    }
+    // Room is kept for the terminating root label, so the whole name stays within max_name_length
+    if (label_length > max_label_length || offset + 1 + label_length > size ||
+        length + 1 + label_length + 1 > max_name_length) {
+      return false;
+    }
+    // Copied as received, the whole name is folded at the end
+    std::memcpy(name.data + length, bytes + offset, 1 + label_length);
+    length += 1 + label_length;
+    offset += 1 + label_length;
+  }
+  return false;
+}
+
+std::string wireName(const std::string &dotted) {
+  FoldedName folded;
+  if (!foldName(dotted, folded)) {
+    return std::string();
+  }
+  // Same layout as the folded name, only the label bytes differ
+  std::string wire = folded.str();
+  size_t offset = 0;
+  size_t start = 0;
+  while (wire[offset]) {
+    const size_t label_length = wire[offset];
+    wire.replace(offset + 1, label_length, dotted, start, label_length);
+    offset += 1 + label_length;
+    start += label_length + 1;
+  }
+  return wire;
+}
+
+bool foldName(const std::string &dotted, FoldedName &name) {
+  size_t length = 0;
+  size_t start = 0;
+  while (start < dotted.size()) {
+    size_t end = dotted.find('.', start);
+    if (end == std::string::npos) {
+      end = dotted.size();
+    }
+    const size_t label_length = end - start;
+    if (!label_length || label_length > max_label_length || length + 1 + label_length + 1 > max_name_length) {
+      return false;
+    }
+    name.data[length++] = static_cast<std::uint8_t>(label_length);
+    std::memcpy(name.data + length, dotted.data() + start, label_length);
+    length += label_length;
+    start = end + 1;
+  }
+  name.data[length++] = 0;
+  name.length = length;
+  foldAndHash(name);
+  return true;
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace mdns_cpp {
+
+// Maximum length of an uncompressed domain name in wire format (RFC 1035 section 2.3.4)
+constexpr size_t max_name_length = 255;
+
+// A domain name in uncompressed wire format with ASCII letters folded to lower case, plus a hash of those bytes. Two
+// names compare equal under DNS rules exactly when their folded forms are byte-wise equal, which makes this the key for
+// hash lookups of incoming question names. Names are folded with SSE2 or AVX2 where the compiler targets them, the
+// bytes of data past length are unspecified.
+struct FoldedName {
+  std::uint8_t data[max_name_length + 1];
+  size_t length{0};
+  std::uint64_t hash{0};
+
+  std::string str() const { return std::string(reinterpret_cast<const char *>(data), length); }
+};
+
+// Decodes the (possibly compressed) name at offset in a received packet. Returns false if the name is malformed,
+// loops or does not fit in max_name_length.
+bool foldName(const void *buffer, size_t size, size_t offset, FoldedName &name);
+
+// Encodes a dotted name such as "_http._tcp.local." (trailing dot optional). Returns false if a label is empty or
+// longer than 63 bytes, or the name does not fit in max_name_length.
+bool foldName(const std::string &dotted, FoldedName &name);
+
+// Encodes a dotted name in uncompressed wire format keeping the case of every label, as written into outgoing records.
+// Returns an empty string for names foldName would reject.
+std::string wireName(const std::string &dotted);
+
+// Hashes bytes a word at a time. The hash of a FoldedName equals hashFoldedName(data, length), it is computed while the
+// name is folded.
+std::uint64_t hashFoldedName(const std::uint8_t *data, size_t length);
+
+// True if the length bytes at raw, with ASCII letters folded to lower case, equal the length bytes at folded. Compares
+// 16 or 32 bytes per step where SSE2 or AVX2 is enabled at compile time.
+bool foldedEquals(const std::uint8_t *raw, const std::uint8_t *folded, size_t length);
+
+inline bool operator==(const FoldedName &lhs, const FoldedName &rhs) {
+  return lhs.hash == rhs.hash && lhs.length == rhs.length && std::memcmp(lhs.data, rhs.data, lhs.length) == 0;
+}
+
+inline std::uint64_t mixHash(std::uint64_t lhs, std::uint64_t rhs) {
+  return (lhs ^ (rhs + 0x9e3779b97f4a7c15ull + (lhs << 6) + (lhs >> 2))) * 0xff51afd7ed558ccdull;
+}
+
+// Identifies a record by owner name, type and data. Names are compared case-insensitively through their folded hashes,
+// the data hash of PTR and SRV records covers the folded target name and raw bytes are hashed for all other types.
+inline std::uint64_t recordDigest(std::uint64_t name_hash, std::uint16_t rtype, std::uint64_t rdata_hash) {
+  return mixHash(mixHash(name_hash, rtype), rdata_hash);
+}
+
+inline std::uint64_t hashBytes(const void *data, size_t length) {
+  return hashFoldedName(static_cast<const std::uint8_t *>(data), length);
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,29 @@
+#include "latency_estimator.hpp"
+
+#include <algorithm>
+
+namespace mdns_cpp {
+
+void LatencyEstimator::sample(Clock::duration gap) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!sampled_) {
+    sampled_ = true;
+    smoothed_ = gap;
+    deviation_ = gap / 2;
+    return;
+  }
+  // Gains of 1/4 and 1/8 (RFC 6298 section 2)
+  const Clock::duration error = (gap > smoothed_) ? gap - smoothed_ : smoothed_ - gap;
+  deviation_ = (deviation_ * 3 + error) / 4;
+  smoothed_ = (smoothed_ * 7 + gap) / 8;
+}
+
+LatencyEstimator::Clock::duration LatencyEstimator::quietPeriod(Clock::duration fallback) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!sampled_) {
+    return fallback;
+  }
+  return std::max<Clock::duration>(smoothed_ + 4 * deviation_, min_quiet_period);
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+namespace mdns_cpp {
+
+// Learns how long the responses to a query keep coming, for queries with an adaptive quiet period.
+//
+// Samples are the gaps between the responses to a query, the first one counted from when the query was sent. They are
+// smoothed like round-trip times in RFC 6298, and the quiet period is the smoothed gap plus four times its mean
+// deviation: long enough for the later responders of a query, short enough that a lookup answered by a single host
+// ends a few milliseconds after the answer. All functions may be called from any thread.
+class LatencyEstimator {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // The adaptive quiet period never gets shorter, a single fast sample must not cut off the next query
+  static constexpr std::chrono::milliseconds min_quiet_period{20};
+
+  void sample(Clock::duration gap);
+
+  // The learned quiet period, fallback until the first sample
+  Clock::duration quietPeriod(Clock::duration fallback) const;
+
+ private:
+  mutable std::mutex mutex_;
+  bool sampled_{false};
+  Clock::duration smoothed_{};
+  Clock::duration deviation_{};
+};
+
+}  // namespace mdns_cpp
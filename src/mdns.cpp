@@ -1,36 +1,65 @@
 #include "mdns_cpp/mdns.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <thread>
 
+#include "batch_receiver.hpp"
+#include "client_socket_pool.hpp"
+#include "dns_name.hpp"
+#include "latency_estimator.hpp"
 #include "mdns.h"
 #include "mdns_cpp/logger.hpp"
 #include "mdns_cpp/macros.hpp"
 #include "mdns_cpp/utils.hpp"
-
-#ifdef _WIN32
-#include <iphlpapi.h>
-#else
-#include <ifaddrs.h>
-#include <netdb.h>
+#include "message_builder.hpp"
+#include "packet_index.hpp"
+#include "qsbr.hpp"
+#include "query_engine.hpp"
+#include "reactor.hpp"
+#include "record_cache.hpp"
+#include "record_decoder.hpp"
+#include "responder.hpp"
+#include "response_scheduler.hpp"
+#include "service_registry.hpp"
+
+#ifndef _WIN32
 #include <netinet/in.h>
 #endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <string.h>
 
 namespace mdns_cpp {
 
-static mdns_record_txt_t txtbuffer[128];
+// Picks the service worker answering a multicast query. All workers see the same source address for a datagram.
+static std::size_t queryOwner(const sockaddr *from, size_t addrlen, std::size_t workers) {
+  return static_cast<std::size_t>(hashBytes(from, addrlen) % workers);
+}
+
+static void pinToCore(std::size_t worker) {
+#ifdef __linux__
+  const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(worker % cores, &cpus);
+  const int res = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (res != 0) {
+    MDNS_LOG << "Failed to pin service worker " << worker << " to a core: " << strerror(res) << "\n";
+  }
+#else
+  (void)sizeof(worker);
+#endif
+}
 
-int mDNS::openServiceSockets(int *sockets, int max_sockets) {
+int mDNS::openServiceSockets(mdns_socket_info_t *sockets, int max_sockets) {
   // When receiving, each socket can receive data from all network interfaces
   // Thus we only need to open one socket for each address family
   int num_sockets = 0;
 
-  // Call the client socket function to enumerate and get local addresses,
-  // but not open the actual sockets
-  openClientSockets(0, 0, 0);
-
   if (num_sockets < max_sockets) {
     sockaddr_in sock_addr{};
     sock_addr.sin_family = AF_INET;
@@ -45,7 +74,7 @@ int mDNS::openServiceSockets(int *sockets, int max_sockets) {
 #endif
     const int sock = mdns_socket_open_ipv4(&sock_addr);
     if (sock >= 0) {
-      sockets[num_sockets++] = sock;
+      mdns_socket_describe(sock, 0, &sockets[num_sockets++]);
     }
   }
 
@@ -58,354 +87,405 @@ int mDNS::openServiceSockets(int *sockets, int max_sockets) {
     sock_addr.sin6_len = sizeof(struct sockaddr_in6);
 #endif
     int sock = mdns_socket_open_ipv6(&sock_addr);
-    if (sock >= 0) sockets[num_sockets++] = sock;
+    if (sock >= 0) mdns_socket_describe(sock, 0, &sockets[num_sockets++]);
   }
 
   return num_sockets;
 }
 
-int mDNS::openClientSockets(int *sockets, int max_sockets, int port) {
+int mDNS::openClientSockets(mdns_socket_info_t *sockets, int max_sockets, int port) {
   // When sending, each socket can only send to one network interface
   // Thus we need to open one socket for each interface and address family
   int num_sockets = 0;
 
-#ifdef _WIN32
-
-  IP_ADAPTER_ADDRESSES *adapter_address = nullptr;
-  ULONG address_size = 8000;
-  unsigned int ret{};
-  unsigned int num_retries = 4;
-  do {
-    adapter_address = (IP_ADAPTER_ADDRESSES *)malloc(address_size);
-    ret = GetAdaptersAddresses(AF_UNSPEC, GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_ANYCAST, 0, adapter_address,
-                               &address_size);
-    if (ret == ERROR_BUFFER_OVERFLOW) {
-      free(adapter_address);
-      adapter_address = 0;
+  int first_ipv4 = 1;
+  int first_ipv6 = 1;
+  for (const InterfaceAddress &local : listInterfaceAddresses()) {
+    int log_addr = 0;
+    if (local.address.ss_family == AF_INET) {
+      if (first_ipv4) {
+        service_address_ipv4_ = reinterpret_cast<const sockaddr_in *>(&local.address)->sin_addr.s_addr;
+        first_ipv4 = 0;
+        log_addr = 1;
+      }
+      has_ipv4_ = 1;
     } else {
-      break;
+      if (first_ipv6) {
+        memcpy(service_address_ipv6_, &reinterpret_cast<const sockaddr_in6 *>(&local.address)->sin6_addr, 16);
+        first_ipv6 = 0;
+        log_addr = 1;
+      }
+      has_ipv6_ = 1;
+    }
+    if (num_sockets < max_sockets) {
+      if (openInterfaceSocket(local, port, sockets[num_sockets]) >= 0) {
+        ++num_sockets;
+        log_addr = 1;
+      } else {
+        log_addr = 0;
+      }
     }
-  } while (num_retries-- > 0);
+    if (log_addr) {
+      char buffer[128] = {};
+      const auto *saddr = reinterpret_cast<const sockaddr *>(&local.address);
+      const auto addr = ipAddressToString(buffer, sizeof(buffer), saddr, local.address_length);
+      MDNS_LOG << "Local IPv" << (local.address.ss_family == AF_INET ? "4" : "6") << " address: " << addr << "\n";
+    }
+  }
 
-  if (!adapter_address || (ret != NO_ERROR)) {
-    free(adapter_address);
-    LogMessage() << "Failed to get network adapter addresses\n";
-    return num_sockets;
+  return num_sockets;
+}
+
+namespace {
+
+// Hands the records of a blocking query or discovery to the caller
+struct RecordSink {
+  const RecordCallback *on_record;
+  RecordCache *cache;
+  unsigned int interface_index;
+  QueryRecord record;
+  // Counts the PTR records named question. No record is delivered after the packet that brought max_answers of them
+  // (0: no limit).
+  const FoldedName *question;
+  std::size_t max_answers;
+  std::size_t answers;
+  std::size_t delivered;
+  bool satisfied;
+};
+
+// The blocking queries without a policy of their own wait until no record arrived for 5 seconds
+constexpr QueryPolicy blocking_policy{std::chrono::milliseconds(0), 0, std::chrono::milliseconds(5000), false};
+
+}  // namespace
+
+// Sends a query with a single PTR question multicast on socket
+static bool sendQuestion(MessageBuilder &message, const mdns_socket_info_t &socket, const std::string &wire_name,
+                         std::uint16_t rclass) {
+  message.begin(0, 0);
+  return message.writer().addQuestion(wire_name, MDNS_RECORDTYPE_PTR, rclass) &&
+         !mdns_multicast_send_info(&socket, message.data(0), message.size(0));
+}
+
+static void deliverRecord(RecordSink &sink, const RecordView &view) {
+  if (sink.satisfied || !decodeRecord(view, sink.record)) {
+    return;
   }
+  sink.record.interface_index = sink.interface_index;
+  if (view.section() != RecordSection::Authority) {
+    sink.cache->insert(sink.record, view.rclass(), RecordCache::Clock::now());
+  }
+  (*sink.on_record)(sink.record);
+  ++sink.delivered;
+  if (sink.question && view.type() == MDNS_RECORDTYPE_PTR && view.name().equals(*sink.question)) {
+    ++sink.answers;
+  }
+}
 
-  int first_ipv4 = 1;
-  int first_ipv6 = 1;
-  for (PIP_ADAPTER_ADDRESSES adapter = adapter_address; adapter; adapter = adapter->Next) {
-    if (adapter->TunnelType == TUNNEL_TYPE_TEREDO) {
-      continue;
+// Delivers the records of a DNS-SD discovery response: the answers to the meta query and every other record. Anything
+// but an answer to the meta query sent by executeDiscovery (ID 0, PTR questions of class IN) is ignored.
+static size_t deliverDiscovery(RecordSink &sink, const PacketIndex &index, const FoldedName &meta_query) {
+  // According to RFC 6762 the query ID MUST match the sent query ID, which is 0
+  if (index.packet().id() || index.packet().flags() != 0x8400) {
+    return 0;
+  }
+  // A response need not echo the question, but any question it carries must be the meta query
+  for (size_t iquestion = 0; iquestion < index.questionCount(); ++iquestion) {
+    const QuestionView question = index.question(iquestion);
+    if (question.rtype != MDNS_RECORDTYPE_PTR || (question.rclass & 0x7FFF) != MDNS_CLASS_IN ||
+        !question.name.equals(meta_query)) {
+      return 0;
     }
-    if (adapter->OperStatus != IfOperStatusUp) {
-      continue;
+  }
+  const size_t delivered = sink.delivered;
+  for (size_t irecord = 0; irecord < index.recordCount(); ++irecord) {
+    const RecordView record = index.record(irecord);
+    if (record.section() != RecordSection::Answer || record.name().equals(meta_query)) {
+      deliverRecord(sink, record);
     }
+  }
+  return sink.delivered - delivered;
+}
 
-    for (IP_ADAPTER_UNICAST_ADDRESS *unicast = adapter->FirstUnicastAddress; unicast; unicast = unicast->Next) {
-      if (unicast->Address.lpSockaddr->sa_family == AF_INET) {
-        struct sockaddr_in *saddr = (struct sockaddr_in *)unicast->Address.lpSockaddr;
-        if ((saddr->sin_addr.S_un.S_un_b.s_b1 != 127) || (saddr->sin_addr.S_un.S_un_b.s_b2 != 0) ||
-            (saddr->sin_addr.S_un.S_un_b.s_b3 != 0) || (saddr->sin_addr.S_un.S_un_b.s_b4 != 1)) {
-          int log_addr = 0;
-          if (first_ipv4) {
-            service_address_ipv4_ = saddr->sin_addr.S_un.S_addr;
-            first_ipv4 = 0;
-            log_addr = 1;
-          }
-          has_ipv4_ = 1;
-          if (num_sockets < max_sockets) {
-            saddr->sin_port = htons((unsigned short)port);
-            int sock = mdns_socket_open_ipv4(saddr);
-            if (sock >= 0) {
-              sockets[num_sockets++] = sock;
-              log_addr = 1;
-            } else {
-              log_addr = 0;
-            }
-          }
-          if (log_addr) {
-            char buffer[128];
-            const auto addr = ipv4AddressToString(buffer, sizeof(buffer), saddr, sizeof(struct sockaddr_in));
-            MDNS_LOG << "Local IPv4 address: " << addr << "\n";
-          }
-        }
-      } else if (unicast->Address.lpSockaddr->sa_family == AF_INET6) {
-        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)unicast->Address.lpSockaddr;
-        static constexpr unsigned char localhost[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
-        static constexpr unsigned char localhost_mapped[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x7f, 0, 0, 1};
-        if ((unicast->DadState == NldsPreferred) && memcmp(saddr->sin6_addr.s6_addr, localhost, 16) &&
-            memcmp(saddr->sin6_addr.s6_addr, localhost_mapped, 16)) {
-          int log_addr = 0;
-          if (first_ipv6) {
-            memcpy(service_address_ipv6_, &saddr->sin6_addr, 16);
-            first_ipv6 = 0;
-            log_addr = 1;
-          }
-          has_ipv6_ = 1;
-          if (num_sockets < max_sockets) {
-            saddr->sin6_port = htons((unsigned short)port);
-            int sock = mdns_socket_open_ipv6(saddr);
-            if (sock >= 0) {
-              sockets[num_sockets++] = sock;
-              log_addr = 1;
-            } else {
-              log_addr = 0;
-            }
-          }
-          if (log_addr) {
-            char buffer[128];
-            const auto addr = ipv6AddressToString(buffer, sizeof(buffer), saddr, sizeof(struct sockaddr_in6));
-            MDNS_LOG << "Local IPv6 address: " << addr << "\n";
-          }
+// Logs a record, for the variants of executeQuery and executeDiscovery without a record callback
+static void logRecord(const QueryRecord &record) {
+  const char *section = (record.section == RecordSection::Answer)
+                            ? "answer"
+                            : ((record.section == RecordSection::Authority) ? "authority" : "additional");
+  LogMessage message;
+  message << "interface " << record.interface_index << " : " << section << " " << record.name;
+
+  char buffer[64];
+  switch (record.type) {
+    case MDNS_RECORDTYPE_PTR:
+      message << " PTR " << record.target << " ttl " << record.ttl;
+      break;
+    case MDNS_RECORDTYPE_SRV:
+      message << " SRV " << record.target << " priority " << record.priority << " weight " << record.weight
+              << " port " << record.port;
+      break;
+    case MDNS_RECORDTYPE_A: {
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = record.address_ipv4;
+      message << " A " << ipv4AddressToString(buffer, sizeof(buffer), &addr, sizeof(addr));
+      break;
+    }
+    case MDNS_RECORDTYPE_AAAA: {
+      sockaddr_in6 addr{};
+      addr.sin6_family = AF_INET6;
+      memcpy(&addr.sin6_addr, record.address_ipv6, sizeof(record.address_ipv6));
+      message << " AAAA " << ipv6AddressToString(buffer, sizeof(buffer), &addr, sizeof(addr));
+      break;
+    }
+    case MDNS_RECORDTYPE_TXT:
+      message << " TXT";
+      for (const TxtEntry &entry : record.txt_entries) {
+        message << " " << record.txtKey(entry);
+        if (entry.has_value) {
+          message << " = " << record.txtValue(entry);
         }
       }
-    }
+      break;
+    default:
+      message << " type " << record.type << " ttl " << record.ttl;
+      break;
   }
+  message << "\n";
+}
 
-  free(adapter_address);
-
-#else
+// Passes the fresh records the cache holds for a PTR query to on_record, returns false if there are none
+static bool answerFromCache(RecordCache &cache, const std::string &name, const RecordCallback &on_record) {
+  FoldedName folded;
+  std::vector<QueryRecord> records;
+  if (!foldName(name, folded) || !cache.answer(folded, MDNS_RECORDTYPE_PTR, RecordCache::Clock::now(), records)) {
+    return false;
+  }
+  MDNS_LOG << "Answering mDNS query for " << name << " from the record cache\n";
+  for (const QueryRecord &record : records) {
+    on_record(record);
+  }
+  return true;
+}
 
-  struct ifaddrs *ifaddr = nullptr;
-  struct ifaddrs *ifa = nullptr;
+mDNS::mDNS()
+    : record_cache_(std::make_shared<RecordCache>()), query_latency_(std::make_shared<LatencyEstimator>()) {
+  auto registry = std::make_unique<ServiceRegistry>();
+  default_service_ = registry->add(defaultServiceInstance());
+  registry_ = registry.release();
+  service_changes_ = std::make_unique<ServiceChanges>();
+}
 
-  if (getifaddrs(&ifaddr) < 0) {
-    MDNS_LOG << "Unable to get interface addresses\n";
+mDNS::~mDNS() {
+  stopService();
+  if (query_engine_) {
+    query_engine_->stop();
   }
+  delete registry_.load();
+}
 
-  int first_ipv4 = 1;
-  int first_ipv6 = 1;
-  for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
-    if (!ifa->ifa_addr) {
-      continue;
-    }
-
-    if (ifa->ifa_addr->sa_family == AF_INET) {
-      struct sockaddr_in *saddr = (struct sockaddr_in *)ifa->ifa_addr;
-      if (saddr->sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
-        int log_addr = 0;
-        if (first_ipv4) {
-          service_address_ipv4_ = saddr->sin_addr.s_addr;
-          first_ipv4 = 0;
-          log_addr = 1;
-        }
-        has_ipv4_ = 1;
-        if (num_sockets < max_sockets) {
-          saddr->sin_port = htons(port);
-          int sock = mdns_socket_open_ipv4(saddr);
-          if (sock >= 0) {
-            sockets[num_sockets++] = sock;
-            log_addr = 1;
-          } else {
-            log_addr = 0;
-          }
-        }
-        if (log_addr) {
-          char buffer[128];
-          const auto addr = ipv4AddressToString(buffer, sizeof(buffer), saddr, sizeof(struct sockaddr_in));
-          MDNS_LOG << "Local IPv4 address: " << addr << "\n";
-        }
-      }
-    } else if (ifa->ifa_addr->sa_family == AF_INET6) {
-      struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)ifa->ifa_addr;
-      static constexpr unsigned char localhost[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
-      static constexpr unsigned char localhost_mapped[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0x7f, 0, 0, 1};
-      if (memcmp(saddr->sin6_addr.s6_addr, localhost, 16) && memcmp(saddr->sin6_addr.s6_addr, localhost_mapped, 16)) {
-        int log_addr = 0;
-        if (first_ipv6) {
-          memcpy(service_address_ipv6_, &saddr->sin6_addr, 16);
-          first_ipv6 = 0;
-          log_addr = 1;
-        }
-        has_ipv6_ = 1;
-        if (num_sockets < max_sockets) {
-          saddr->sin6_port = htons(port);
-          int sock = mdns_socket_open_ipv6(saddr);
-          if (sock >= 0) {
-            sockets[num_sockets++] = sock;
-            log_addr = 1;
-          } else {
-            log_addr = 0;
-          }
-        }
-        if (log_addr) {
-          char buffer[128] = {};
-          const auto addr = ipv6AddressToString(buffer, sizeof(buffer), saddr, sizeof(struct sockaddr_in6));
-          MDNS_LOG << "Local IPv6 address: " << addr << "\n";
-        }
-      }
-    }
+void mDNS::startService() {
+  if (running_) {
+    stopService();
   }
 
-  freeifaddrs(ifaddr);
+  // Call the client socket function to enumerate and get local addresses,
+  // but not open the actual sockets
+  openClientSockets(0, 0, 0);
+  updateRegistry([this](ServiceRegistry &registry) {
+    registry.setAddresses(has_ipv4_ ? service_address_ipv4_ : 0, has_ipv6_ ? service_address_ipv6_ : nullptr);
+    return true;
+  });
 
+#ifdef __linux__
+  const std::size_t workers = std::max<std::size_t>(service_workers_, 1);
+#else
+  const std::size_t workers = 1;
 #endif
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    registry_readers_ = std::make_unique<QsbrDomain>(workers);
+  }
+  multicast_history_ = std::make_unique<MulticastHistory>();
+  reactors_.clear();
+  for (std::size_t worker = 0; worker < workers; ++worker) {
+    reactors_.push_back(std::make_unique<Reactor>());
+  }
 
-  return num_sockets;
+  MDNS_LOG << "Service mDNS: " << name_ << ":" << port_ << "\n";
+  MDNS_LOG << "Hostname: " << hostname_.data() << "\n";
+
+  running_ = true;
+  for (std::size_t worker = 0; worker < workers; ++worker) {
+    worker_threads_.emplace_back([this, worker]() { this->runMainLoop(worker); });
+  }
 }
 
-static int query_callback(int sock, const struct sockaddr *from, size_t addrlen, mdns_entry_type_t entry,
-                          uint16_t query_id, uint16_t rtype, uint16_t rclass, uint32_t ttl, const void *data,
-                          size_t size, size_t name_offset, size_t name_length, size_t record_offset,
-                          size_t record_length, void *user_data) {
-  (void)sizeof(sock);
-  (void)sizeof(query_id);
-  (void)sizeof(name_length);
-  (void)sizeof(user_data);
-
-  static char addrbuffer[64]{};
-  static char namebuffer[256]{};
-  static char entrybuffer[256]{};
-
-  const auto fromaddrstr = ipAddressToString(addrbuffer, sizeof(addrbuffer), from, addrlen);
-  const char *entrytype =
-      (entry == MDNS_ENTRYTYPE_ANSWER) ? "answer" : ((entry == MDNS_ENTRYTYPE_AUTHORITY) ? "authority" : "additional");
-  mdns_string_t entrystr = mdns_string_extract(data, size, &name_offset, entrybuffer, sizeof(entrybuffer));
-
-  const int str_capacity = 1000;
-  char str_buffer[str_capacity]={};
-
-  if (rtype == MDNS_RECORDTYPE_PTR) {
-    mdns_string_t namestr =
-        mdns_record_parse_ptr(data, size, record_offset, record_length, namebuffer, sizeof(namebuffer));
-
-    snprintf(str_buffer, str_capacity, "%s : %s %.*s PTR %.*s rclass 0x%x ttl %u length %d\n", fromaddrstr.data(),
-             entrytype, MDNS_STRING_FORMAT(entrystr), MDNS_STRING_FORMAT(namestr), rclass, ttl, (int)record_length);
-  } else if (rtype == MDNS_RECORDTYPE_SRV) {
-    mdns_record_srv_t srv =
-        mdns_record_parse_srv(data, size, record_offset, record_length, namebuffer, sizeof(namebuffer));
-    snprintf(str_buffer, str_capacity,"%s : %s %.*s SRV %.*s priority %d weight %d port %d\n", fromaddrstr.data(), entrytype,
-           MDNS_STRING_FORMAT(entrystr), MDNS_STRING_FORMAT(srv.name), srv.priority, srv.weight, srv.port);
-  } else if (rtype == MDNS_RECORDTYPE_A) {
-    struct sockaddr_in addr;
-    mdns_record_parse_a(data, size, record_offset, record_length, &addr);
-    const auto addrstr = ipv4AddressToString(namebuffer, sizeof(namebuffer), &addr, sizeof(addr));
-    snprintf(str_buffer, str_capacity,"%s : %s %.*s A %s\n", fromaddrstr.data(), entrytype, MDNS_STRING_FORMAT(entrystr), addrstr.data());
-  } else if (rtype == MDNS_RECORDTYPE_AAAA) {
-    struct sockaddr_in6 addr;
-    mdns_record_parse_aaaa(data, size, record_offset, record_length, &addr);
-    const auto addrstr = ipv6AddressToString(namebuffer, sizeof(namebuffer), &addr, sizeof(addr));
-    snprintf(str_buffer, str_capacity,"%s : %s %.*s AAAA %s\n", fromaddrstr.data(), entrytype, MDNS_STRING_FORMAT(entrystr), addrstr.data());
-  } else if (rtype == MDNS_RECORDTYPE_TXT) {
-    size_t parsed = mdns_record_parse_txt(data, size, record_offset, record_length, txtbuffer,
-                                          sizeof(txtbuffer) / sizeof(mdns_record_txt_t));
-    for (size_t itxt = 0; itxt < parsed; ++itxt) {
-      if (txtbuffer[itxt].value.length) {
-        snprintf(str_buffer, str_capacity,"%s : %s %.*s TXT %.*s = %.*s\n", fromaddrstr.data(), entrytype, MDNS_STRING_FORMAT(entrystr),
-               MDNS_STRING_FORMAT(txtbuffer[itxt].key), MDNS_STRING_FORMAT(txtbuffer[itxt].value));
-      } else {
-        snprintf(str_buffer, str_capacity,"%s : %s %.*s TXT %.*s\n", fromaddrstr.data(), entrytype, MDNS_STRING_FORMAT(entrystr),
-               MDNS_STRING_FORMAT(txtbuffer[itxt].key));
-      }
+void mDNS::stopService() {
+  running_ = false;
+  for (auto &reactor : reactors_) {
+    reactor->wakeup();
+  }
+  for (auto &thread : worker_threads_) {
+    if (thread.joinable()) {
+      thread.join();
     }
-  } else {
-    snprintf(str_buffer, str_capacity,"%s : %s %.*s type %u rclass 0x%x ttl %u length %d\n", fromaddrstr.data(), entrytype,
-           MDNS_STRING_FORMAT(entrystr), rtype, rclass, ttl, (int)record_length);
   }
-  MDNS_LOG << std::string(str_buffer);
+  worker_threads_.clear();
+}
 
-  return 0;
+bool mDNS::isServiceRunning() { return running_; }
+
+void mDNS::setServiceHostname(const std::string &hostname) {
+  hostname_ = hostname;
+  updateDefaultService();
 }
 
-int service_callback(int sock, const struct sockaddr *from, size_t addrlen, mdns_entry_type entry, uint16_t query_id,
-                     uint16_t rtype, uint16_t rclass, uint32_t ttl, const void *data, size_t size, size_t name_offset,
-                     size_t name_length, size_t record_offset, size_t record_length, void *user_data) {
-  (void)sizeof(name_offset);
-  (void)sizeof(name_length);
-  (void)sizeof(ttl);
+void mDNS::setServicePort(std::uint16_t port) {
+  port_ = port;
+  updateDefaultService();
+}
 
-  if (static_cast<int>(entry) != MDNS_ENTRYTYPE_QUESTION) {
-    return 0;
+void mDNS::setServiceName(const std::string &name) {
+  name_ = name;
+  updateDefaultService();
+}
+
+void mDNS::setServiceTxtRecord(const std::string &txt_record) {
+  txt_record_ = txt_record;
+  updateDefaultService();
+}
+
+ServiceInstance mDNS::defaultServiceInstance() const {
+  ServiceInstance instance;
+  instance.name = name_;
+  instance.hostname = hostname_;
+  instance.port = port_;
+  instance.txt_record = txt_record_;
+  return instance;
+}
+
+template <typename Fn>
+bool mDNS::updateRegistry(Fn &&fn) {
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  const ServiceRegistry *current = registry_.load();
+  auto next = std::make_unique<ServiceRegistry>(*current);
+  if (!fn(*next)) {
+    return false;
   }
 
-  char addrbuffer[64] = {0};
-  char namebuffer[256] = {0};
-
-  const auto fromaddrstr = ipAddressToString(addrbuffer, sizeof(addrbuffer), from, addrlen);
-  if (rtype == static_cast<uint16_t>(mdns_record_type::MDNS_RECORDTYPE_PTR)) {
-    const mdns_string_t service =
-        mdns_record_parse_ptr(data, size, record_offset, record_length, namebuffer, sizeof(namebuffer));
-    MDNS_LOG << fromaddrstr << " : question PTR " << std::string(service.str, service.length) << "\n";
-
-    const char dns_sd[] = "_services._dns-sd._udp.local.";
-    const ServiceRecord *service_record = (const ServiceRecord *)user_data;
-    const size_t service_length = strlen(service_record->service);
-    char sendbuffer[256] = {0};
-
-    if ((service.length == (sizeof(dns_sd) - 1)) && (strncmp(service.str, dns_sd, sizeof(dns_sd) - 1) == 0)) {
-      MDNS_LOG << "  --> answer " << service_record->service << " \n";
-      mdns_discovery_answer(sock, from, addrlen, sendbuffer, sizeof(sendbuffer), service_record->service,
-                            service_length);
-    } else if ((service.length == service_length) &&
-               (strncmp(service.str, service_record->service, service_length) == 0)) {
-      uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-      MDNS_LOG << "  --> answer " << service_record->hostname << "." << service_record->service << " port "
-               << service_record->port << " (" << (unicast ? "unicast" : "multicast") << ")\n";
-      if (!unicast) addrlen = 0;
-      char txt_record[] = "asdf=1";
-      mdns_query_answer(sock, from, addrlen, sendbuffer, sizeof(sendbuffer), query_id, service_record->service,
-                        service_length, service_record->hostname, strlen(service_record->hostname),
-                        service_record->address_ipv4, service_record->address_ipv6, (uint16_t)service_record->port,
-                        txt_record, sizeof(txt_record));
-    }
-  } else if (rtype == static_cast<uint16_t>(mdns_record_type::MDNS_RECORDTYPE_SRV)) {
-    mdns_record_srv_t service =
-        mdns_record_parse_srv(data, size, record_offset, record_length, namebuffer, sizeof(namebuffer));
-    MDNS_LOG << fromaddrstr << " : question SRV  " << std::string(service.name.str, service.name.length) << "\n";
-#if 0
-		if ((service.length == service_length) &&
-		    (strncmp(service.str, service_record->service, service_length) == 0)) {
-			uint16_t unicast = (rclass & MDNS_UNICAST_RESPONSE);
-			printf("  --> answer %s.%s port %d (%s)\n", service_record->hostname,
-			       service_record->service, service_record->port,
-			       (unicast ? "unicast" : "multicast"));
-			if (!unicast)
-				addrlen = 0;
-			char txt_record[] = "test=1";
-			mdns_query_answer(sock, from, addrlen, sendbuffer, sizeof(sendbuffer), query_id,
-			                  service_record->service, service_length, service_record->hostname,
-			                  strlen(service_record->hostname), service_record->address_ipv4,
-			                  service_record->address_ipv6, (uint16_t)service_record->port,
-			                  txt_record, sizeof(txt_record));
-		}
-#endif
+  // Workers pick up the new version with their next batch of packets, the old one is freed once none can hold it
+  registry_ = next.release();
+  if (registry_readers_) {
+    registry_readers_->synchronize();
+  }
+  delete current;
+  // The first worker multicasts the changes, reading the registry they were made in
+  service_changes_->publish();
+  if (running_) {
+    reactors_.front()->wakeup();
   }
-  return 0;
+  return true;
 }
 
-mDNS::~mDNS() { stopService(); }
+void mDNS::updateDefaultService() {
+  const ServiceInstance instance = defaultServiceInstance();
+  bool removed = false;
+  const bool updated = updateRegistry([&](ServiceRegistry &registry) {
+    removed = !default_service_;
+    return !removed && changeService(registry, default_service_, &instance);
+  });
+  if (!updated && !removed) {
+    MDNS_LOG << "Invalid service name " << hostname_ << "." << name_ << "\n";
+  }
+}
 
-void mDNS::startService() {
+bool mDNS::changeService(ServiceRegistry &registry, ServiceId id, const ServiceInstance *instance) {
+  const ServiceRegistry::Entry *entry = registry.find(id);
+  if (!entry) {
+    return false;
+  }
+  // The goodbyes are written once the registry holding the entry is freed, so they need a copy of it
+  const ServiceRegistry::Entry previous = *entry;
+  if (instance ? !registry.update(id, *instance) : !registry.remove(id)) {
+    return false;
+  }
   if (running_) {
-    stopService();
+    service_changes_->withdraw(previous);
+    if (instance) {
+      service_changes_->announce(id);
+    }
   }
-
-  running_ = true;
-  worker_thread_ = std::thread([this]() { this->runMainLoop(); });
+  return true;
 }
 
-void mDNS::stopService() {
-  running_ = false;
-  if (worker_thread_.joinable()) {
-    worker_thread_.join();
+ServiceId mDNS::addService(const ServiceInstance &instance) {
+  ServiceId id = 0;
+  updateRegistry([&](ServiceRegistry &registry) {
+    id = registry.add(instance);
+    if (id && running_) {
+      service_changes_->announce(id);
+    }
+    return id != 0;
+  });
+  if (!id) {
+    throw std::invalid_argument("Invalid service name " + instance.hostname + "." + instance.name);
   }
+  return id;
 }
 
-bool mDNS::isServiceRunning() { return running_; }
+bool mDNS::updateService(ServiceId id, const ServiceInstance &instance) {
+  return updateRegistry([&](ServiceRegistry &registry) { return changeService(registry, id, &instance); });
+}
+
+bool mDNS::removeService(ServiceId id) {
+  return updateRegistry([&](ServiceRegistry &registry) {
+    if (!changeService(registry, id, nullptr)) {
+      return false;
+    }
+    if (id == default_service_) {
+      default_service_ = 0;
+    }
+    return true;
+  });
+}
 
-void mDNS::setServiceHostname(const std::string &hostname) { hostname_ = hostname; }
+void mDNS::setReceiveBatchSize(std::size_t batch_size) { receive_batch_size_ = batch_size; }
+
+void mDNS::setMaxPacketSize(std::size_t bytes) {
+  max_packet_size_ = (bytes < MessageBuilder::min_mtu) ? MessageBuilder::min_mtu : bytes;
+}
+
+void mDNS::setServiceWorkers(std::size_t workers) {
+#ifndef __linux__
+  if (workers > 1) {
+    MDNS_LOG << "Multiple service workers are only supported on Linux\n";
+  }
+#endif
+  service_workers_ = workers;
+}
 
-void mDNS::setServicePort(std::uint16_t port) { port_ = port; }
+ReceiveStatistics mDNS::getReceiveStatistics() const {
+  ReceiveStatistics statistics;
+  statistics.packets = received_packets_.load(std::memory_order_relaxed);
+  statistics.syscalls = receive_syscalls_.load(std::memory_order_relaxed);
+  return statistics;
+}
 
-void mDNS::setServiceName(const std::string &name) { name_ = name; }
+std::size_t mDNS::receive(BatchReceiver &receiver, int sock) {
+  const auto packets = receiver.packets();
+  const auto syscalls = receiver.syscalls();
+  const size_t received = receiver.receive(sock);
+  received_packets_.fetch_add(receiver.packets() - packets, std::memory_order_relaxed);
+  receive_syscalls_.fetch_add(receiver.syscalls() - syscalls, std::memory_order_relaxed);
+  return received;
+}
 
-void mDNS::setServiceTxtRecord(const std::string &txt_record) { txt_record_ = txt_record; }
+void mDNS::runMainLoop(std::size_t worker) {
+  const std::size_t workers = reactors_.size();
+  Reactor &reactor = *reactors_[worker];
 
-void mDNS::runMainLoop() {
   constexpr size_t number_of_sockets = 32;
-  int sockets[number_of_sockets];
+  mdns_socket_info_t sockets[number_of_sockets];
   const int num_sockets = openServiceSockets(sockets, sizeof(sockets) / sizeof(sockets[0]));
   if (num_sockets <= 0) {
     const auto msg = "Error: Failed to open any client sockets";
@@ -413,167 +493,359 @@ void mDNS::runMainLoop() {
     throw std::runtime_error(msg);
   }
 
+  if (workers > 1) {
+    pinToCore(worker);
+  }
+
   MDNS_LOG << "Opened " << std::to_string(num_sockets) << " socket" << (num_sockets ? "s" : "")
            << " for mDNS service\n";
-  MDNS_LOG << "Service mDNS: " << name_ << ":" << port_ << "\n";
-  MDNS_LOG << "Hostname: " << hostname_.data() << "\n";
 
-  constexpr size_t capacity = 2048u;
-  std::shared_ptr<void> buffer(malloc(capacity), free);
-  ServiceRecord service_record{};
-  service_record.service = name_.data();
-  service_record.hostname = hostname_.data();
-  service_record.address_ipv4 = has_ipv4_ ? service_address_ipv4_ : 0;
-  service_record.address_ipv6 = has_ipv6_ ? service_address_ipv6_ : 0;
-  service_record.port = port_;
+  BatchReceiver receiver(receive_batch_size_);
+  ResponseScheduler scheduler(*multicast_history_, max_packet_size_);
+  Responder responder(scheduler);
+  QsbrDomain &readers = *registry_readers_;
 
-  // This is a crude implementation that checks for incoming queries
+  for (int isock = 0; isock < num_sockets; ++isock) {
+    scheduler.addSocket(sockets[isock]);
+    if (workers > 1) {
+      BatchReceiver::requestDestination(sockets[isock].sock, sockets[isock].family);
+    }
+    reactor.add(sockets[isock].sock);
+  }
+  if (worker == 0) {
+    scheduler.announce(ResponseScheduler::Clock::now());
+  }
+
+  // Block until a query arrives, a scheduled answer is due or stopService() wakes us up
+  int ready[number_of_sockets];
   while (running_) {
-    int nfds = 0;
-    fd_set readfs{};
-    FD_ZERO(&readfs);
-    for (int isock = 0; isock < num_sockets; ++isock) {
-      if (sockets[isock] >= nfds) nfds = sockets[isock] + 1;
-      FD_SET(sockets[isock], &readfs);
+    const int num_ready = reactor.wait(ready, num_sockets, scheduler.timeout(ResponseScheduler::Clock::now()));
+    if (num_ready < 0) {
+      break;
     }
 
-    if (select(nfds, &readfs, 0, 0, 0) >= 0) {
-      for (int isock = 0; isock < num_sockets; ++isock) {
-        if (FD_ISSET(sockets[isock], &readfs)) {
-          mdns_socket_listen(sockets[isock], buffer.get(), capacity, service_callback, &service_record);
+    readers.online(worker);
+    const ServiceRegistry &registry = *registry_.load();
+    if (worker == 0) {
+      service_changes_->apply(scheduler, registry, ResponseScheduler::Clock::now());
+    }
+    for (int iready = 0; iready < num_ready; ++iready) {
+      const size_t received = receive(receiver, ready[iready]);
+      for (size_t ipacket = 0; ipacket < received; ++ipacket) {
+        // Every worker receives a copy of each multicast datagram, unicast ones are spread by the kernel
+        if (workers > 1 && receiver.multicast(ipacket) &&
+            queryOwner(receiver.from(ipacket), receiver.addrlen(ipacket), workers) != worker) {
+          continue;
         }
-        FD_SET(sockets[isock], &readfs);
+        responder.handlePacket(registry, ready[iready], receiver.from(ipacket), receiver.addrlen(ipacket),
+                               receiver.data(ipacket), receiver.size(ipacket));
       }
-    } else {
-      break;
     }
+
+    const auto now = ResponseScheduler::Clock::now();
+    if (scheduler.timeout(now) == 0) {
+      scheduler.flush(registry, now);
+    }
+    readers.offline(worker);
   }
 
   for (int isock = 0; isock < num_sockets; ++isock) {
-    mdns_socket_close(sockets[isock]);
+    reactor.remove(sockets[isock].sock);
+    mdns_socket_close(sockets[isock].sock);
   }
   MDNS_LOG << "Closed socket " << (num_sockets ? "s" : "") << "\n";
 }
 
-void mDNS::executeQuery(const std::string &service) {
-  int sockets[32];
-  int query_id[32];
-  int num_sockets = openClientSockets(sockets, sizeof(sockets) / sizeof(sockets[0]), 0);
+void mDNS::executeQuery(const std::string &service) { executeQuery(service, logRecord); }
 
-  if (num_sockets <= 0) {
+ClientSocketPool &mDNS::clientSockets(BatchReceiver &receiver) {
+  if (!client_sockets_) {
+    client_sockets_ = std::make_unique<ClientSocketPool>();
+  }
+  if (client_sockets_->refresh()) {
+    MDNS_LOG << "Using " << client_sockets_->sockets().size() << " client sockets\n";
+  }
+  if (client_sockets_->sockets().empty()) {
     const auto msg = "Failed to open any client sockets";
     MDNS_LOG << msg << "\n";
     throw std::runtime_error(msg);
   }
-  MDNS_LOG << "Opened " << num_sockets << " socket" << (num_sockets ? "s" : "") << " for mDNS query\n";
 
-  size_t capacity = 2048;
-  void *buffer = malloc(capacity);
-  void *user_data = 0;
-  size_t records;
+  // Discard late responses to an earlier query
+  for (const mdns_socket_info_t &socket : client_sockets_->sockets()) {
+    while (receiver.receive(socket.sock) == receiver.batchSize()) {
+    }
+  }
+  return *client_sockets_;
+}
+
+void mDNS::executeQuery(const std::string &service, const RecordCallback &on_record) {
+  executeQuery(service, on_record, blocking_policy);
+}
+
+void mDNS::executeQuery(const std::string &service, const RecordCallback &on_record, const QueryPolicy &policy) {
+  // An adaptive quiet period falls back to quiet_period until it is learned, so it cannot end the query alone
+  if (policy.timeout.count() <= 0 && !policy.max_answers && policy.quiet_period.count() <= 0) {
+    throw std::invalid_argument("The query policy never ends the query");
+  }
+  if (answerFromCache(*record_cache_, service, on_record)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(client_mutex_);
+  BatchReceiver receiver(receive_batch_size_);
+  const std::vector<mdns_socket_info_t> &sockets = clientSockets(receiver).sockets();
+  const int num_sockets = static_cast<int>(sockets.size());
+  std::vector<int> query_id(sockets.size());
+
+  MessageBuilder message(max_packet_size_);
+  const std::string wire_name = wireName(service);
+  FoldedName question;
+  RecordSink sink{&on_record, record_cache_.get(), 0, {}, foldName(service, question) ? &question : nullptr,
+                  policy.max_answers, 0, 0, false};
+  PacketIndex index;
 
   MDNS_LOG << "Sending mDNS query: " << service << "\n";
   for (int isock = 0; isock < num_sockets; ++isock) {
-    query_id[isock] = mdns_query_send(sockets[isock], MDNS_RECORDTYPE_PTR, service.data(), strlen(service.data()),
-                                      buffer, capacity, 0);
+    const std::uint16_t rclass = MDNS_CLASS_IN | (sockets[isock].unicast_response ? MDNS_UNICAST_RESPONSE : 0);
+    query_id[isock] = sendQuestion(message, sockets[isock], wire_name, rclass) ? 0 : -1;
     if (query_id[isock] < 0) {
       MDNS_LOG << "Failed to send mDNS query: " << strerror(errno) << "\n";
     }
   }
 
-  // This is a simple implementation that loops for 5 seconds or as long as we
-  // get replies
-  int res{};
+  Reactor reactor;
+  for (int isock = 0; isock < num_sockets; ++isock) {
+    reactor.add(sockets[isock].sock);
+  }
+
+  using Clock = LatencyEstimator::Clock;
+  const auto sent = Clock::now();
+  const auto deadline = (policy.timeout.count() > 0) ? sent + policy.timeout : Clock::time_point::max();
+  const Clock::duration quiet_period =
+      policy.adaptive ? query_latency_->quietPeriod(policy.quiet_period) : Clock::duration(policy.quiet_period);
+  auto last_received = sent;
+
+  std::vector<int> ready(sockets.size());
   MDNS_LOG << "Reading mDNS query replies\n";
-  do {
-    struct timeval timeout;
-    timeout.tv_sec = 5;
-    timeout.tv_usec = 0;
-
-    int nfds = 0;
-    fd_set readfs;
-    FD_ZERO(&readfs);
-    for (int isock = 0; isock < num_sockets; ++isock) {
-      if (sockets[isock] >= nfds) nfds = sockets[isock] + 1;
-      FD_SET(sockets[isock], &readfs);
+  while (!sink.satisfied) {
+    auto until = deadline;
+    if (quiet_period.count() > 0) {
+      until = std::min(until, last_received + quiet_period);
     }
-
-    records = 0;
-    res = select(nfds, &readfs, 0, 0, &timeout);
-    if (res > 0) {
-      for (int isock = 0; isock < num_sockets; ++isock) {
-        if (FD_ISSET(sockets[isock], &readfs)) {
-          records += mdns_query_recv(sockets[isock], buffer, capacity, query_callback, user_data, query_id[isock]);
+    int timeout_ms = -1;
+    if (until != Clock::time_point::max()) {
+      const auto now = Clock::now();
+      if (now >= until) {
+        break;
+      }
+      timeout_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(until - now).count());
+    }
+    const int res = reactor.wait(ready.data(), num_sockets, timeout_ms);
+    if (res < 0) {
+      MDNS_LOG << "Failed to wait for mDNS query replies: " << strerror(errno) << "\n";
+      break;
+    }
+    const size_t delivered = sink.delivered;
+    for (int iready = 0; iready < res; ++iready) {
+      const int isock = static_cast<int>(
+          std::find_if(sockets.begin(), sockets.end(),
+                       [&](const mdns_socket_info_t &socket) { return socket.sock == ready[iready]; }) -
+          sockets.begin());
+      if (isock == num_sockets) {
+        continue;
+      }
+      sink.interface_index = sockets[isock].interface_index;
+      const size_t received = receive(receiver, ready[iready]);
+      for (size_t ipacket = 0; ipacket < received; ++ipacket) {
+        const PacketView packet(receiver.data(ipacket), receiver.size(ipacket));
+        if ((query_id[isock] > 0 && packet.id() != query_id[isock]) || !index.build(packet.data(), packet.size())) {
+          continue;
+        }
+        for (size_t irecord = 0; irecord < index.recordCount(); ++irecord) {
+          deliverRecord(sink, index.record(irecord));
         }
-        FD_SET(sockets[isock], &readfs);
+        sink.satisfied = policy.max_answers && sink.answers >= policy.max_answers;
       }
     }
-  } while (res > 0);
-
-  free(buffer);
+    if (sink.delivered != delivered) {
+      // Records arrived, which restarts the quiet period
+      const auto now = Clock::now();
+      query_latency_->sample(now - last_received);
+      last_received = now;
+    }
+  }
 
   for (int isock = 0; isock < num_sockets; ++isock) {
-    mdns_socket_close(sockets[isock]);
+    reactor.remove(sockets[isock].sock);
   }
-  MDNS_LOG << "Closed socket" << (num_sockets ? "s" : "") << "\n";
 }
 
-void mDNS::executeDiscovery() {
-  int sockets[32];
-  int num_sockets = openClientSockets(sockets, sizeof(sockets) / sizeof(sockets[0]), 0);
-  if (num_sockets <= 0) {
-    const auto msg = "Failed to open any client sockets";
-    MDNS_LOG << msg << "\n";
-    throw std::runtime_error(msg);
+void mDNS::executeDiscovery() { executeDiscovery(logRecord); }
+
+void mDNS::executeDiscovery(const RecordCallback &on_record) {
+  if (answerFromCache(*record_cache_, "_services._dns-sd._udp.local.", on_record)) {
+    return;
   }
+  std::lock_guard<std::mutex> lock(client_mutex_);
+  BatchReceiver receiver(receive_batch_size_);
+  const std::vector<mdns_socket_info_t> &sockets = clientSockets(receiver).sockets();
+  const int num_sockets = static_cast<int>(sockets.size());
 
-  MDNS_LOG << "Opened " << num_sockets << " socket" << (num_sockets ? "s" : "") << " for DNS-SD\n";
+  MessageBuilder message(max_packet_size_);
   MDNS_LOG << "Sending DNS-SD discovery\n";
   for (int isock = 0; isock < num_sockets; ++isock) {
-    if (mdns_discovery_send(sockets[isock])) {
+    if (!sendQuestion(message, sockets[isock], wireName("_services._dns-sd._udp.local."),
+                      MDNS_CLASS_IN | MDNS_UNICAST_RESPONSE)) {
       MDNS_LOG << "Failed to send DNS-DS discovery: " << strerror(errno) << " \n";
     }
   }
 
-  size_t capacity = 2048;
-  void *buffer = malloc(capacity);
-  void *user_data = 0;
+  RecordSink sink{&on_record, record_cache_.get(), 0, {}, nullptr, 0, 0, 0, false};
   size_t records;
+  FoldedName meta_query;
+  foldName("_services._dns-sd._udp.local.", meta_query);
+  PacketIndex index;
+
+  Reactor reactor;
+  for (int isock = 0; isock < num_sockets; ++isock) {
+    reactor.add(sockets[isock].sock);
+  }
 
   // This is a simple implementation that loops for 5 seconds or as long as we
   // get replies
   int res;
+  std::vector<int> ready(sockets.size());
   MDNS_LOG << "Reading DNS-SD replies\n";
   do {
-    struct timeval timeout;
-    timeout.tv_sec = 5;
-    timeout.tv_usec = 0;
-
-    int nfds = 0;
-    fd_set readfs;
-    FD_ZERO(&readfs);
-    for (int isock = 0; isock < num_sockets; ++isock) {
-      if (sockets[isock] >= nfds) nfds = sockets[isock] + 1;
-      FD_SET(sockets[isock], &readfs);
-    }
-
     records = 0;
-    res = select(nfds, &readfs, 0, 0, &timeout);
-    if (res > 0) {
-      for (int isock = 0; isock < num_sockets; ++isock) {
-        if (FD_ISSET(sockets[isock], &readfs)) {
-          records += mdns_discovery_recv(sockets[isock], buffer, capacity, query_callback, user_data);
+    res = reactor.wait(ready.data(), num_sockets, 5000);
+    for (int iready = 0; iready < res; ++iready) {
+      const auto socket = std::find_if(sockets.begin(), sockets.end(), [&](const mdns_socket_info_t &info) {
+        return info.sock == ready[iready];
+      });
+      sink.interface_index = (socket != sockets.end()) ? socket->interface_index : 0;
+      const size_t received = receive(receiver, ready[iready]);
+      for (size_t ipacket = 0; ipacket < received; ++ipacket) {
+        if (index.build(receiver.data(ipacket), receiver.size(ipacket))) {
+          records += deliverDiscovery(sink, index, meta_query);
         }
       }
     }
   } while (res > 0);
 
-  free(buffer);
-
   for (int isock = 0; isock < num_sockets; ++isock) {
-    mdns_socket_close(sockets[isock]);
+    reactor.remove(sockets[isock].sock);
   }
-  MDNS_LOG << "Closed socket" << (num_sockets ? "s" : "") << "\n";
+}
+
+void mDNS::setRecordCacheCapacity(std::size_t capacity) { record_cache_->setCapacity(capacity); }
+
+void mDNS::clearRecordCache() { record_cache_->clear(); }
+
+bool QueryHandle::cancel() {
+  const auto engine = engine_.lock();
+  return engine && engine->cancel(id_);
+}
+
+std::shared_ptr<QueryEngine> mDNS::queryEngine() {
+  std::lock_guard<std::mutex> lock(query_mutex_);
+  if (!query_engine_) {
+    query_engine_ =
+        std::make_shared<QueryEngine>(receive_batch_size_, max_packet_size_, record_cache_, query_latency_);
+  }
+  return query_engine_;
+}
+
+QueryHandle mDNS::startQuery(const std::string &name, RecordType type, RecordCallback on_record,
+                             QueryDoneCallback on_done, std::chrono::milliseconds timeout) {
+  QueryPolicy policy;
+  policy.timeout = timeout;
+  return startQuery(name, type, std::move(on_record), std::move(on_done), policy);
+}
+
+QueryHandle mDNS::startQuery(const std::string &name, RecordType type, RecordCallback on_record,
+                             QueryDoneCallback on_done, const QueryPolicy &policy) {
+  FoldedName folded;
+  if (!foldName(name, folded)) {
+    throw std::invalid_argument("Invalid query name " + name);
+  }
+  auto engine = queryEngine();
+  const QueryId id = engine->submit(name, static_cast<std::uint16_t>(type), std::move(on_record), std::move(on_done),
+                                    policy);
+  if (!id) {
+    throw std::runtime_error("The mDNS query thread has stopped");
+  }
+  return QueryHandle(engine, id);
+}
+
+QueryHandle mDNS::browse(const std::string &name, RecordType type, BrowseCallback on_event,
+                         QueryDoneCallback on_done) {
+  FoldedName folded;
+  if (!foldName(name, folded)) {
+    throw std::invalid_argument("Invalid query name " + name);
+  }
+  auto engine = queryEngine();
+  const QueryId id = engine->browse(name, static_cast<std::uint16_t>(type), std::move(on_event), std::move(on_done));
+  if (!id) {
+    throw std::runtime_error("The mDNS query thread has stopped");
+  }
+  return QueryHandle(engine, id);
+}
+
+QueryHandle mDNS::resolve(const std::string &service, ResolveCallback on_resolved, QueryDoneCallback on_done,
+                          const QueryPolicy &policy) {
+  FoldedName folded;
+  if (!foldName(service, folded)) {
+    throw std::invalid_argument("Invalid service name " + service);
+  }
+  auto engine = queryEngine();
+  const QueryId id = engine->resolve(service, std::move(on_resolved), std::move(on_done), policy);
+  if (!id) {
+    throw std::runtime_error("The mDNS query thread has stopped");
+  }
+  return QueryHandle(engine, id);
+}
+
+std::future<std::vector<ResolvedService>> mDNS::resolveAsync(const std::string &service, const QueryPolicy &policy) {
+  auto promise = std::make_shared<std::promise<std::vector<ResolvedService>>>();
+  auto services = std::make_shared<std::vector<ResolvedService>>();
+  auto future = promise->get_future();
+  resolve(
+      service, [services](const ResolvedService &resolved) { services->push_back(resolved); },
+      [promise, services](QueryStatus status) {
+        if (status == QueryStatus::Failed) {
+          promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to send mDNS query")));
+        } else {
+          promise->set_value(std::move(*services));
+        }
+      },
+      policy);
+  return future;
+}
+
+std::future<std::vector<QueryRecord>> mDNS::queryAsync(const std::string &name, RecordType type,
+                                                       std::chrono::milliseconds timeout) {
+  QueryPolicy policy;
+  policy.timeout = timeout;
+  return queryAsync(name, type, policy);
+}
+
+std::future<std::vector<QueryRecord>> mDNS::queryAsync(const std::string &name, RecordType type,
+                                                       const QueryPolicy &policy) {
+  auto promise = std::make_shared<std::promise<std::vector<QueryRecord>>>();
+  auto records = std::make_shared<std::vector<QueryRecord>>();
+  auto future = promise->get_future();
+  startQuery(
+      name, type, [records](const QueryRecord &record) { records->push_back(record); },
+      [promise, records](QueryStatus status) {
+        if (status == QueryStatus::Failed) {
+          promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to send mDNS query")));
+        } else {
+          promise->set_value(std::move(*records));
+        }
+      },
+      policy);
+  return future;
 }
 
 }  // namespace mdns_cpp
@@ -0,0 +1,33 @@
+#include "message_builder.hpp"
+
+namespace mdns_cpp {
+
+MessageBuilder::MessageBuilder(size_t mtu) : mtu_(mtu < min_mtu ? min_mtu : mtu), packet_mtu_(mtu_) {}
+
+void MessageBuilder::setMtu(size_t mtu) { mtu_ = (mtu < min_mtu) ? min_mtu : mtu; }
+
+void MessageBuilder::begin(std::uint16_t query_id, std::uint16_t flags) {
+  query_id_ = query_id;
+  flags_ = flags;
+  packet_mtu_ = mtu_;
+  sizes_.clear();
+  startPacket();
+}
+
+void MessageBuilder::next() {
+  if (writer_.empty()) {
+    return;
+  }
+  sizes_.push_back(writer_.size());
+  startPacket();
+}
+
+void MessageBuilder::startPacket() {
+  const size_t offset = sizes_.size() * packet_mtu_;
+  if (arena_.size() < offset + packet_mtu_) {
+    arena_.resize(offset + packet_mtu_);
+  }
+  writer_.reset(arena_.data() + offset, packet_mtu_, query_id_, flags_);
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "packet_writer.hpp"
+
+namespace mdns_cpp {
+
+// Builds a DNS message of any number of questions and records as a sequence of packets no larger than the MTU.
+//
+// The packets are written back to back into an arena the builder keeps between messages, so once it has grown to the
+// largest message built, building another one does not allocate. add() moves on to a new packet when a question or
+// record does not fit the current one. The known answers of a query continuing in the next packet set the TC bit on
+// the packet they overflow (RFC 6762 section 7.2), any other message is simply split.
+class MessageBuilder {
+ public:
+  // Largest UDP payload that needs no fragmentation on Ethernet, with an IPv6 header
+  static constexpr size_t default_mtu = 1452;
+  // Every DNS implementation accepts messages of this size (RFC 1035 section 2.3.4)
+  static constexpr size_t min_mtu = 512;
+
+  explicit MessageBuilder(size_t mtu = default_mtu);
+
+  size_t mtu() const { return mtu_; }
+  // Takes effect with the next message, raised to min_mtu
+  void setMtu(size_t mtu);
+
+  // Starts a new message with the given header, dropping the packets of the previous one
+  void begin(std::uint16_t query_id, std::uint16_t flags);
+
+  // Writes a question or record with write(PacketWriter &), which returns false if it did not fit. If the current
+  // packet holds anything, it is closed and write is retried on a new one, with the TC bit set on the closed packet if
+  // truncate is true. Returns false, leaving the message as it was, if it does not even fit an empty packet.
+  template <typename Write>
+  bool add(Write &&write, bool truncate = false) {
+    if (write(writer_)) {
+      return true;
+    }
+    // Tried on an empty packet before the current one is closed, so a record too large for any packet neither splits
+    // the message nor sets the TC bit
+    if (writer_.empty() || !fitsEmptyPacket(write)) {
+      return false;
+    }
+    if (truncate) {
+      writer_.setTruncated();
+    }
+    next();
+    return write(writer_);
+  }
+
+  // Closes the current packet unless it is empty and continues the message in a new one
+  void next();
+
+  // The packet being written, for callers filling it record by record
+  PacketWriter &writer() { return writer_; }
+
+  // Packets of the message, the current one included unless it is empty
+  size_t packets() const { return sizes_.size() + (writer_.empty() ? 0 : 1); }
+  const std::uint8_t *data(size_t index) const { return arena_.data() + index * packet_mtu_; }
+  size_t size(size_t index) const { return (index < sizes_.size()) ? sizes_[index] : writer_.size(); }
+
+ private:
+  // Points the writer at the next free slot of the arena, growing it if needed
+  void startPacket();
+  template <typename Write>
+  bool fitsEmptyPacket(Write &write) {
+    scratch_.resize(packet_mtu_);
+    scratch_writer_.reset(scratch_.data(), scratch_.size(), query_id_, flags_);
+    return write(scratch_writer_);
+  }
+
+  size_t mtu_;
+  // MTU of the message being built
+  size_t packet_mtu_;
+  std::uint16_t query_id_{0};
+  std::uint16_t flags_{0};
+  std::vector<std::uint8_t> arena_;
+  // Sizes of the closed packets
+  std::vector<size_t> sizes_;
+  PacketWriter writer_{nullptr, 0};
+  // Packet add() tries a record on before it moves on to a new one
+  std::vector<std::uint8_t> scratch_;
+  PacketWriter scratch_writer_{nullptr, 0};
+};
+
+}  // namespace mdns_cpp
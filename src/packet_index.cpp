@@ -0,0 +1,112 @@
+#include "packet_index.hpp"
+
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+namespace {
+
+constexpr size_t question_fields_size = 4;
+constexpr size_t record_header_size = 10;
+
+// Offset just past the name at offset if it ends before end, invalid_offset otherwise. A pointer must point to an
+// earlier offset. The name it points to is not checked here, that is left to NameView when the name is read.
+size_t skipCheckedName(const std::uint8_t *packet, size_t offset, size_t end) {
+  size_t length = 0;
+  while (offset < end) {
+    const std::uint8_t label_length = packet[offset];
+    if ((label_length & 0xC0) == 0xC0) {
+      if (offset + 2 > end || ((static_cast<size_t>(label_length & 0x3F) << 8) | packet[offset + 1]) >= offset) {
+        return invalid_offset;
+      }
+      return offset + 2;
+    }
+    if (label_length & 0xC0) {
+      return invalid_offset;
+    }
+    if (!label_length) {
+      return offset + 1;
+    }
+    length += 1 + label_length;
+    // Room is kept for the root label
+    if (length + 1 > max_name_length) {
+      return invalid_offset;
+    }
+    offset += 1 + label_length;
+  }
+  return invalid_offset;
+}
+
+}  // namespace
+
+void PacketIndex::clear() {
+  questions_.clear();
+  records_.clear();
+  section_begin_[0] = section_begin_[1] = section_begin_[2] = 0;
+}
+
+bool PacketIndex::build(const void *data, size_t size) {
+  packet_ = PacketView(data, size);
+  clear();
+  if (!packet_.valid() || size > max_packet_size) {
+    return false;
+  }
+  const std::uint8_t *bytes = packet_.data();
+
+  size_t offset = PacketView::header_size;
+  for (std::uint16_t iquestion = packet_.questionCount(); iquestion; --iquestion) {
+    const size_t end = skipCheckedName(bytes, offset, size);
+    if (end == invalid_offset || end + question_fields_size > size) {
+      clear();
+      return false;
+    }
+    questions_.push_back(Question{static_cast<std::uint16_t>(offset), readU16(bytes + end), readU16(bytes + end + 2)});
+    offset = end + question_fields_size;
+  }
+
+  const std::uint16_t counts[3] = {packet_.answerCount(), packet_.authorityCount(), packet_.additionalCount()};
+  bool framed = true;
+  for (int section = 0; section < 3; ++section) {
+    section_begin_[section] = records_.size();
+    for (std::uint16_t irecord = counts[section]; framed && irecord; --irecord) {
+      const size_t end = skipCheckedName(bytes, offset, size);
+      if (end == invalid_offset || end + record_header_size > size) {
+        framed = false;
+        break;
+      }
+      const std::uint8_t *header = bytes + end;
+      const std::uint16_t rtype = readU16(header);
+      const size_t data_offset = end + record_header_size;
+      const size_t data_length = readU16(header + 8);
+      if (data_length > size - data_offset) {
+        framed = false;
+        break;
+      }
+      if (validData(rtype, data_offset, data_length)) {
+        records_.push_back(Record{static_cast<std::uint16_t>(offset), static_cast<std::uint16_t>(data_offset),
+                                  static_cast<std::uint16_t>(data_length), rtype, readU16(header + 2),
+                                  static_cast<std::uint8_t>(section), readU32(header + 4)});
+      }
+      offset = data_offset + data_length;
+    }
+  }
+  return true;
+}
+
+bool PacketIndex::validData(std::uint16_t rtype, size_t offset, size_t length) const {
+  const std::uint8_t *bytes = packet_.data();
+  switch (rtype) {
+    case MDNS_RECORDTYPE_PTR:
+      return skipCheckedName(bytes, offset, offset + length) != invalid_offset;
+    case MDNS_RECORDTYPE_SRV:
+      return length > 6 && skipCheckedName(bytes, offset + 6, offset + length) != invalid_offset;
+    case MDNS_RECORDTYPE_A:
+      return length == 4;
+    case MDNS_RECORDTYPE_AAAA:
+      return length == 16;
+    default:
+      return true;
+  }
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mdns_cpp/defs.hpp"
+#include "packet_view.hpp"
+
+namespace mdns_cpp {
+
+// The questions and records of a received message, found and bounds-checked in a single pass over the packet.
+//
+// build() walks the whole message once and either rejects it or records where each entry lies, so the stages reading
+// it afterwards pick entries by index and never walk the packet again. A message is rejected as a whole if a question
+// named in its header runs past the end of the packet or its name holds a reserved label type or a compression pointer
+// that does not point back to an earlier offset. The records are indexed up to the first one that is malformed the same
+// way, and the records before it are kept, so a response whose last record was cut off still delivers the others. A
+// record whose data does not have the shape of its type (PTR, SRV, A or AAAA) is skipped, the records after it are
+// still indexed. Only the labels up to the first pointer of each name are checked, not the names the pointers lead to,
+// so a pointer may still lead into a chain that loops or runs off the packet. NameView catches those when the name is
+// read, and caps the pointers it follows. A rejected message costs at most one pass over its bytes. The vectors are
+// kept between packets, so an index reused for every packet received does not allocate.
+class PacketIndex {
+ public:
+  // Entries are 16 bit offsets, longer messages are rejected
+  static constexpr size_t max_packet_size = 0xFFFF;
+
+  // Indexes a packet, returns false and leaves the index empty if its header or questions are malformed. The packet
+  // must outlive the views taken from the index.
+  bool build(const void *data, size_t size);
+
+  const PacketView &packet() const { return packet_; }
+
+  size_t questionCount() const { return questions_.size(); }
+  QuestionView question(size_t index) const {
+    const Question &entry = questions_[index];
+    return QuestionView{NameView(packet_.data(), packet_.size(), entry.name_offset), entry.rtype, entry.rclass};
+  }
+
+  // The records of all three sections in packet order, the answers first
+  size_t recordCount() const { return records_.size(); }
+  RecordView record(size_t index) const {
+    const Record &entry = records_[index];
+    return RecordView(packet_.data(), packet_.size(), static_cast<RecordSection>(entry.section), entry.name_offset,
+                      entry.rtype, entry.rclass, entry.ttl, entry.data_offset, entry.data_length);
+  }
+  // Index of the first record of a section, recordCount() if it and the sections after it are empty
+  size_t sectionBegin(RecordSection section) const { return section_begin_[static_cast<int>(section)]; }
+  size_t sectionEnd(RecordSection section) const {
+    return (section == RecordSection::Additional) ? records_.size() : section_begin_[static_cast<int>(section) + 1];
+  }
+
+ private:
+  struct Question {
+    std::uint16_t name_offset;
+    std::uint16_t rtype;
+    std::uint16_t rclass;
+  };
+
+  struct Record {
+    std::uint16_t name_offset;
+    std::uint16_t data_offset;
+    std::uint16_t data_length;
+    std::uint16_t rtype;
+    std::uint16_t rclass;
+    std::uint8_t section;
+    std::uint32_t ttl;
+  };
+
+  void clear();
+  // Checks the record data of the types whose data is read as a name or an address
+  bool validData(std::uint16_t rtype, size_t offset, size_t length) const;
+
+  PacketView packet_{nullptr, 0};
+  std::vector<Question> questions_;
+  std::vector<Record> records_;
+  size_t section_begin_[3]{0, 0, 0};
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,71 @@
+#include "packet_view.hpp"
+
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+namespace {
+
+// Bounds the pointers followed while decoding a name, so compression loops end, as in foldName
+constexpr int max_pointer_jumps = 128;
+
+}  // namespace
+
+bool NameView::decode(std::string &out) const {
+  out.clear();
+  size_t offset = offset_;
+  int jumps = 0;
+  while (packet_ && offset < size_) {
+    const std::uint8_t label_length = packet_[offset];
+    if ((label_length & 0xC0) == 0xC0) {
+      if (offset + 2 > size_ || ++jumps > max_pointer_jumps) {
+        break;
+      }
+      offset = ((label_length & 0x3F) << 8) | packet_[offset + 1];
+      continue;
+    }
+    if (!label_length) {
+      return !out.empty();
+    }
+    // The dotted form is one byte shorter than the wire form, which ends in the root label
+    if ((label_length & 0xC0) || offset + 1 + label_length > size_ ||
+        out.size() + label_length + 1 + 1 > max_name_length) {
+      break;
+    }
+    out.append(reinterpret_cast<const char *>(packet_) + offset + 1, label_length);
+    out.push_back('.');
+    offset += 1 + label_length;
+  }
+  out.clear();
+  return false;
+}
+
+bool NameView::equals(const FoldedName &name) const {
+  size_t offset = offset_;
+  size_t position = 0;
+  int jumps = 0;
+  while (packet_ && offset < size_) {
+    // The labels up to the next pointer or the root lie contiguous in both names and are compared in one go. Length
+    // bytes are not changed by folding, so equal runs also have equal labels.
+    size_t end = offset;
+    while (end < size_ && packet_[end] && !(packet_[end] & 0xC0)) {
+      end += 1 + packet_[end];
+    }
+    if (end >= size_ || position + (end - offset) >= name.length ||
+        !foldedEquals(packet_ + offset, name.data + position, end - offset)) {
+      return false;
+    }
+    position += end - offset;
+    const std::uint8_t label_length = packet_[end];
+    if (!label_length) {
+      return position + 1 == name.length;
+    }
+    if ((label_length & 0xC0) != 0xC0 || end + 2 > size_ || ++jumps > max_pointer_jumps) {
+      return false;
+    }
+    offset = ((label_length & 0x3F) << 8) | packet_[end + 1];
+  }
+  return false;
+}
+
+}  // namespace mdns_cpp
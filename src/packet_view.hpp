@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "dns_name.hpp"
+#include "mdns_cpp/defs.hpp"
+
+namespace mdns_cpp {
+
+// An offset past any packet, for names that do not fit in theirs
+constexpr size_t invalid_offset = ~size_t(0);
+
+inline std::uint16_t readU16(const std::uint8_t *bytes) {
+  return static_cast<std::uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+inline std::uint32_t readU32(const std::uint8_t *bytes) {
+  return (static_cast<std::uint32_t>(bytes[0]) << 24) | (static_cast<std::uint32_t>(bytes[1]) << 16) |
+         (static_cast<std::uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+// A name in a received packet. Nothing is decoded until asked for, and then straight from the packet.
+class NameView {
+ public:
+  NameView() = default;
+  NameView(const std::uint8_t *packet, size_t size, size_t offset) : packet_(packet), size_(size), offset_(offset) {}
+
+  size_t offset() const { return offset_; }
+
+  bool fold(FoldedName &name) const { return packet_ && foldName(packet_, size_, offset_, name); }
+  // Stores the name in dotted form with a trailing dot ("box.local."), returns false and clears out if it is malformed
+  bool decode(std::string &out) const;
+  // Compares case-insensitively with a folded name, label by label
+  bool equals(const FoldedName &name) const;
+
+ private:
+  const std::uint8_t *packet_{nullptr};
+  size_t size_{0};
+  size_t offset_{0};
+};
+
+struct QuestionView {
+  NameView name;
+  std::uint16_t rtype{0};
+  // As received, including the unicast-response bit
+  std::uint16_t rclass{0};
+
+  bool unicastResponse() const { return (rclass & 0x8000) != 0; }
+};
+
+struct SrvView {
+  std::uint16_t priority{0};
+  std::uint16_t weight{0};
+  std::uint16_t port{0};
+  NameView target;
+};
+
+// A resource record in a received packet. The fixed fields are read while stepping to the record, the typed accessors
+// read only the record data they need and fail if it is too short for the type.
+class RecordView {
+ public:
+  RecordView() = default;
+  RecordView(const std::uint8_t *packet, size_t size, RecordSection section, size_t name_offset, std::uint16_t rtype,
+             std::uint16_t rclass, std::uint32_t ttl, size_t data_offset, size_t data_length)
+      : packet_(packet),
+        size_(size),
+        section_(section),
+        name_offset_(name_offset),
+        rtype_(rtype),
+        rclass_(rclass),
+        ttl_(ttl),
+        data_offset_(data_offset),
+        data_length_(data_length) {}
+
+  NameView name() const { return NameView(packet_, size_, name_offset_); }
+  RecordSection section() const { return section_; }
+  std::uint16_t type() const { return rtype_; }
+  // As received, including the cache-flush bit
+  std::uint16_t rclass() const { return rclass_; }
+  std::uint32_t ttl() const { return ttl_; }
+  size_t dataOffset() const { return data_offset_; }
+  size_t dataLength() const { return data_length_; }
+  const std::uint8_t *data() const { return packet_ + data_offset_; }
+
+  // PTR and CNAME
+  NameView target() const { return NameView(packet_, size_, data_offset_); }
+  bool srv(SrvView &srv) const {
+    if (data_length_ < 7) {
+      return false;
+    }
+    srv.priority = readU16(data());
+    srv.weight = readU16(data() + 2);
+    srv.port = readU16(data() + 4);
+    srv.target = NameView(packet_, size_, data_offset_ + 6);
+    return true;
+  }
+  // The address in network byte order
+  bool ipv4(std::uint32_t &address) const {
+    if (data_length_ < 4) {
+      return false;
+    }
+    std::memcpy(&address, data(), 4);
+    return true;
+  }
+  bool ipv6(std::uint8_t (&address)[16]) const {
+    if (data_length_ < 16) {
+      return false;
+    }
+    std::memcpy(address, data(), 16);
+    return true;
+  }
+  std::string_view txt() const { return std::string_view(reinterpret_cast<const char *>(data()), data_length_); }
+
+ private:
+  const std::uint8_t *packet_{nullptr};
+  size_t size_{0};
+  RecordSection section_{RecordSection::Answer};
+  size_t name_offset_{0};
+  std::uint16_t rtype_{0};
+  std::uint16_t rclass_{0};
+  std::uint32_t ttl_{0};
+  size_t data_offset_{0};
+  size_t data_length_{0};
+};
+
+// The header of a received DNS message, read in place. Its questions and records are found by a PacketIndex.
+class PacketView {
+ public:
+  static constexpr size_t header_size = 12;
+
+  PacketView(const void *data, size_t size) : packet_(static_cast<const std::uint8_t *>(data)), size_(size) {}
+
+  // False if the packet is too short for a header, all counts read as 0 then
+  bool valid() const { return size_ >= header_size; }
+  const std::uint8_t *data() const { return packet_; }
+  size_t size() const { return size_; }
+
+  std::uint16_t id() const { return valid() ? readU16(packet_) : 0; }
+  std::uint16_t flags() const { return valid() ? readU16(packet_ + 2) : 0; }
+  bool isResponse() const { return (flags() & 0x8000) != 0; }
+  bool truncated() const { return (flags() & 0x0200) != 0; }
+  std::uint16_t questionCount() const { return count(0); }
+  std::uint16_t answerCount() const { return count(1); }
+  std::uint16_t authorityCount() const { return count(2); }
+  std::uint16_t additionalCount() const { return count(3); }
+
+ private:
+  std::uint16_t count(int index) const { return valid() ? readU16(packet_ + 4 + 2 * index) : 0; }
+
+  const std::uint8_t *packet_;
+  size_t size_;
+};
+
+}  // namespace mdns_cpp
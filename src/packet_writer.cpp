@@ -0,0 +1,254 @@
+#include "packet_writer.hpp"
+
+#include <string.h>
+
+#include "dns_name.hpp"
+
+namespace mdns_cpp {
+
+namespace {
+
+constexpr size_t questions_offset = 4;
+// Compression pointers hold 14 bit offsets
+constexpr size_t max_pointer_offset = 0x3FFF;
+constexpr int max_pointer_jumps = 128;
+
+size_t sectionCountOffset(PacketWriter::Section section) {
+  switch (section) {
+    case PacketWriter::Section::Answer:
+      return 6;
+    case PacketWriter::Section::Authority:
+      return 8;
+    case PacketWriter::Section::Additional:
+    default:
+      return 10;
+  }
+}
+
+}  // namespace
+
+PacketWriter::PacketWriter(void *buffer, size_t capacity)
+    : buffer_(static_cast<std::uint8_t *>(buffer)), capacity_(capacity) {}
+
+void PacketWriter::reset(std::uint16_t query_id, std::uint16_t flags) {
+  size_ = 0;
+  records_ = 0;
+  rollback(0);
+  if (capacity_ < header_size) {
+    return;
+  }
+  memset(buffer_, 0, header_size);
+  buffer_[0] = static_cast<std::uint8_t>(query_id >> 8);
+  buffer_[1] = static_cast<std::uint8_t>(query_id);
+  buffer_[2] = static_cast<std::uint8_t>(flags >> 8);
+  buffer_[3] = static_cast<std::uint8_t>(flags);
+  size_ = header_size;
+}
+
+void PacketWriter::reset(void *buffer, size_t capacity, std::uint16_t query_id, std::uint16_t flags) {
+  buffer_ = static_cast<std::uint8_t *>(buffer);
+  capacity_ = capacity;
+  reset(query_id, flags);
+}
+
+void PacketWriter::setTruncated() {
+  if (size_ >= header_size) {
+    buffer_[2] |= 0x02;
+  }
+}
+
+bool PacketWriter::write(const void *data, size_t length) {
+  if (length > capacity_ - size_) {
+    return false;
+  }
+  memcpy(buffer_ + size_, data, length);
+  size_ += length;
+  return true;
+}
+
+bool PacketWriter::write16(std::uint16_t value) {
+  const std::uint8_t bytes[2] = {static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value)};
+  return write(bytes, sizeof(bytes));
+}
+
+bool PacketWriter::write32(std::uint32_t value) {
+  return write16(static_cast<std::uint16_t>(value >> 16)) && write16(static_cast<std::uint16_t>(value));
+}
+
+bool PacketWriter::nameAt(size_t offset, const std::uint8_t *name) const {
+  for (int jumps = 0; jumps <= max_pointer_jumps && offset < size_;) {
+    const std::uint8_t length = buffer_[offset];
+    if ((length & 0xC0) == 0xC0) {
+      offset = ((length & 0x3F) << 8) | buffer_[offset + 1];
+      ++jumps;
+      continue;
+    }
+    if (length != *name) {
+      return false;
+    }
+    if (!length) {
+      return true;
+    }
+    if (memcmp(buffer_ + offset + 1, name + 1, length) != 0) {
+      return false;
+    }
+    offset += 1 + length;
+    name += 1 + length;
+  }
+  return false;
+}
+
+size_t PacketWriter::findSuffix(std::uint32_t hash, const std::uint8_t *name) const {
+  for (size_t slot = hash % table_size; table_[slot].offset; slot = (slot + 1) % table_size) {
+    if (table_[slot].hash == hash && nameAt(table_[slot].offset, name)) {
+      return table_[slot].offset;
+    }
+  }
+  return 0;
+}
+
+void PacketWriter::addSuffix(std::uint32_t hash, size_t offset) {
+  if (suffixes_ == max_suffixes || offset > max_pointer_offset) {
+    return;
+  }
+  size_t slot = hash % table_size;
+  while (table_[slot].offset) {
+    slot = (slot + 1) % table_size;
+  }
+  table_[slot] = Suffix{hash, static_cast<std::uint16_t>(offset)};
+  filled_[suffixes_++] = static_cast<std::uint16_t>(slot);
+}
+
+void PacketWriter::rollback(size_t count) {
+  // Undone in reverse order, so no suffix left in the table was probed past a slot emptied here
+  while (suffixes_ > count) {
+    table_[filled_[--suffixes_]].offset = 0;
+  }
+}
+
+bool PacketWriter::writeName(const std::string &name) {
+  if (name.empty()) {
+    return false;
+  }
+  const auto *bytes = reinterpret_cast<const std::uint8_t *>(name.data());
+
+  // Suffixes are looked up from the front, so the first match is the longest one
+  std::uint32_t hashes[max_name_length / 2 + 1];
+  size_t labels = 0;
+  size_t offset = 0;
+  size_t pointer = 0;
+  while (offset < name.size() && bytes[offset]) {
+    hashes[labels] = static_cast<std::uint32_t>(hashBytes(bytes + offset, name.size() - offset));
+    pointer = findSuffix(hashes[labels], bytes + offset);
+    if (pointer) {
+      break;
+    }
+    ++labels;
+    offset += 1 + bytes[offset];
+  }
+
+  const size_t start = size_;
+  const bool ok = pointer ? (write(bytes, offset) && write16(static_cast<std::uint16_t>(0xC000 | pointer)))
+                          : write(bytes, name.size());
+  if (!ok) {
+    return false;
+  }
+  // The labels written out can be pointed to by later names
+  offset = 0;
+  for (size_t label = 0; label < labels; ++label) {
+    addSuffix(hashes[label], start + offset);
+    offset += 1 + bytes[offset];
+  }
+  return true;
+}
+
+void PacketWriter::increment(size_t header_offset) {
+  const std::uint16_t count =
+      static_cast<std::uint16_t>(((buffer_[header_offset] << 8) | buffer_[header_offset + 1]) + 1);
+  buffer_[header_offset] = static_cast<std::uint8_t>(count >> 8);
+  buffer_[header_offset + 1] = static_cast<std::uint8_t>(count);
+}
+
+bool PacketWriter::addQuestion(const std::string &name, std::uint16_t rtype, std::uint16_t rclass) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  if (size_ < header_size || !writeName(name) || !write16(rtype) || !write16(rclass)) {
+    size_ = start;
+    rollback(suffixes);
+    return false;
+  }
+  increment(questions_offset);
+  return true;
+}
+
+bool PacketWriter::beginRecord(Section section, const std::string &name, std::uint16_t rtype, std::uint16_t rclass,
+                               std::uint32_t ttl, size_t &length_pos) {
+  (void)sizeof(section);
+  if (size_ < header_size || !writeName(name) || !write16(rtype) || !write16(rclass) || !write32(ttl)) {
+    return false;
+  }
+  length_pos = size_;
+  return write16(0);
+}
+
+bool PacketWriter::endRecord(Section section, size_t start, size_t suffixes, size_t length_pos, bool ok) {
+  if (!ok) {
+    size_ = start;
+    rollback(suffixes);
+    return false;
+  }
+  const size_t length = size_ - (length_pos + 2);
+  buffer_[length_pos] = static_cast<std::uint8_t>(length >> 8);
+  buffer_[length_pos + 1] = static_cast<std::uint8_t>(length);
+  increment(sectionCountOffset(section));
+  ++records_;
+  return true;
+}
+
+bool PacketWriter::addPtr(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+                          const std::string &target) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  size_t length_pos = 0;
+  const bool ok = beginRecord(section, name, 12, rclass, ttl, length_pos) && writeName(target);
+  return endRecord(section, start, suffixes, length_pos, ok);
+}
+
+bool PacketWriter::addSrv(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+                          std::uint16_t priority, std::uint16_t weight, std::uint16_t port, const std::string &target) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  size_t length_pos = 0;
+  const bool ok = beginRecord(section, name, 33, rclass, ttl, length_pos) && write16(priority) && write16(weight) &&
+                  write16(port) && writeName(target);
+  return endRecord(section, start, suffixes, length_pos, ok);
+}
+
+bool PacketWriter::addTxt(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+                          const void *rdata, size_t length) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  size_t length_pos = 0;
+  const bool ok = (length <= 0xFFFF) && beginRecord(section, name, 16, rclass, ttl, length_pos) && write(rdata, length);
+  return endRecord(section, start, suffixes, length_pos, ok);
+}
+
+bool PacketWriter::addA(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+                        std::uint32_t ipv4) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  size_t length_pos = 0;
+  const bool ok = beginRecord(section, name, 1, rclass, ttl, length_pos) && write(&ipv4, sizeof(ipv4));
+  return endRecord(section, start, suffixes, length_pos, ok);
+}
+
+bool PacketWriter::addAaaa(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+                           const std::uint8_t *ipv6) {
+  const size_t start = size_;
+  const size_t suffixes = suffixes_;
+  size_t length_pos = 0;
+  const bool ok = beginRecord(section, name, 28, rclass, ttl, length_pos) && write(ipv6, 16);
+  return endRecord(section, start, suffixes, length_pos, ok);
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mdns_cpp {
+
+// Serializes a DNS message into a caller supplied buffer.
+//
+// Names are passed in uncompressed wire format (see wireName). Records have to be added section by section (answers,
+// then authority, then additional records) as the header counts are updated in place. A question or record that does
+// not fit the remaining capacity is rolled back completely and reported as false, which leaves the packet valid and
+// lets the caller send it and continue in a new one.
+//
+// All names, of questions, records and the targets of PTR and SRV records, are compressed: the longest suffix already
+// written is replaced by a pointer to it (RFC 1035 section 4.1.4, RFC 6762 section 18.14). Every label written is
+// entered into a hash table of suffixes, so finding the match costs one lookup per label of the name. The table lives
+// in the writer and needs no allocation.
+class PacketWriter {
+ public:
+  enum class Section { Answer, Authority, Additional };
+
+  PacketWriter(void *buffer, size_t capacity);
+
+  void reset(std::uint16_t query_id, std::uint16_t flags);
+  // Starts a new packet in another buffer
+  void reset(void *buffer, size_t capacity, std::uint16_t query_id, std::uint16_t flags);
+  // Sets the TC bit, which tells that the known answers of a query continue in the next packet
+  void setTruncated();
+
+  bool addQuestion(const std::string &name, std::uint16_t rtype, std::uint16_t rclass);
+
+  bool addPtr(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+              const std::string &target);
+  bool addSrv(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+              std::uint16_t priority, std::uint16_t weight, std::uint16_t port, const std::string &target);
+  // rdata is the raw record data, a sequence of length prefixed strings
+  bool addTxt(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl, const void *rdata,
+              size_t length);
+  // ipv4 in network byte order
+  bool addA(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl, std::uint32_t ipv4);
+  bool addAaaa(Section section, const std::string &name, std::uint16_t rclass, std::uint32_t ttl,
+               const std::uint8_t *ipv6);
+
+  const void *data() const { return buffer_; }
+  size_t size() const { return size_; }
+  size_t records() const { return records_; }
+  // True if nothing but the header was written
+  bool empty() const { return size_ <= header_size; }
+
+ private:
+  bool write(const void *data, size_t length);
+  bool write16(std::uint16_t value);
+  bool write32(std::uint32_t value);
+  bool writeName(const std::string &name);
+  // True if the (possibly compressed) name at offset in the packet equals the uncompressed name
+  bool nameAt(size_t offset, const std::uint8_t *name) const;
+  // Offset of a name written earlier that equals the uncompressed name with the given hash, 0 if there is none
+  size_t findSuffix(std::uint32_t hash, const std::uint8_t *name) const;
+  void addSuffix(std::uint32_t hash, size_t offset);
+  // Forgets the suffixes added since the table held count of them
+  void rollback(size_t count);
+
+  // Writes the record header and reserves the data length, returns the position of the length field
+  bool beginRecord(Section section, const std::string &name, std::uint16_t rtype, std::uint16_t rclass,
+                   std::uint32_t ttl, size_t &length_pos);
+  bool endRecord(Section section, size_t start, size_t suffixes, size_t length_pos, bool ok);
+  void increment(size_t header_offset);
+
+  static constexpr size_t header_size = 12;
+
+  std::uint8_t *buffer_;
+  size_t capacity_;
+  size_t size_{0};
+  size_t records_{0};
+
+  // Suffixes written so far, by the hash of their uncompressed form, in an open addressing table with linear probing.
+  // Offset 0 marks an empty slot, no name starts inside the header.
+  struct Suffix {
+    std::uint32_t hash;
+    std::uint16_t offset;
+  };
+  static constexpr size_t table_size = 256;
+  // Kept at three quarters of the table, later labels are not entered
+  static constexpr size_t max_suffixes = table_size / 4 * 3;
+  std::array<Suffix, table_size> table_{};
+  // Slots filled, in order, to empty them on reset and rollback
+  std::array<std::uint16_t, max_suffixes> filled_{};
+  size_t suffixes_{0};
+};
+
+}  // namespace mdns_cpp
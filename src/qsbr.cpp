@@ -0,0 +1,23 @@
+#include "qsbr.hpp"
+
+#include <thread>
+
+namespace mdns_cpp {
+
+QsbrDomain::QsbrDomain(size_t readers) : slots_(readers) {}
+
+void QsbrDomain::synchronize() {
+  // Readers that went online before this point may have loaded the old pointer, later ones see the new one
+  const std::uint64_t epoch = epoch_.fetch_add(1) + 1;
+  for (auto &slot : slots_) {
+    while (true) {
+      const std::uint64_t seen = slot.epoch.load();
+      if (!seen || seen >= epoch) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mdns_cpp {
+
+// Quiescent-state based reclamation for data the service workers read without taking locks.
+//
+// Each reader thread owns a slot and is online while it may hold pointers to published data; the service workers go
+// online for every batch of packets and offline while they wait. A writer publishes the new version first and then
+// calls synchronize(), which returns once every reader that might still see the previous version has gone offline.
+// The previous version can be freed after that. Readers never block and never write shared cache lines.
+class QsbrDomain {
+ public:
+  explicit QsbrDomain(size_t readers);
+
+  QsbrDomain(const QsbrDomain &) = delete;
+  QsbrDomain &operator=(const QsbrDomain &) = delete;
+
+  void online(size_t reader) { slots_[reader].epoch.store(epoch_.load()); }
+  void offline(size_t reader) { slots_[reader].epoch.store(0); }
+
+  // Waits for a grace period. Must not be called by an online reader.
+  void synchronize();
+
+ private:
+  // One cache line per reader so readers do not contend with each other
+  struct alignas(64) Slot {
+    // 0 while offline, otherwise the writer epoch seen when going online
+    std::atomic<std::uint64_t> epoch{0};
+  };
+
+  std::atomic<std::uint64_t> epoch_{1};
+  std::vector<Slot> slots_;
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,135 @@
+#include "query_batch.hpp"
+
+#include <algorithm>
+
+#include "dns_name.hpp"
+
+namespace mdns_cpp {
+
+namespace {
+
+bool writeKnownAnswer(PacketWriter &writer, const QueryRecord &record) {
+  constexpr auto section = PacketWriter::Section::Answer;
+  const std::string name = wireName(record.name);
+  switch (record.type) {
+    case MDNS_RECORDTYPE_PTR:
+      return writer.addPtr(section, name, MDNS_CLASS_IN, record.ttl, wireName(record.target));
+    case MDNS_RECORDTYPE_SRV:
+      return writer.addSrv(section, name, MDNS_CLASS_IN, record.ttl, record.priority, record.weight, record.port,
+                           wireName(record.target));
+    case MDNS_RECORDTYPE_TXT:
+      return writer.addTxt(section, name, MDNS_CLASS_IN, record.ttl, record.txt.data(), record.txt.size());
+    case MDNS_RECORDTYPE_A:
+      return writer.addA(section, name, MDNS_CLASS_IN, record.ttl, record.address_ipv4);
+    case MDNS_RECORDTYPE_AAAA:
+      return writer.addAaaa(section, name, MDNS_CLASS_IN, record.ttl, record.address_ipv6);
+    default:
+      // Not understood, so never held
+      return true;
+  }
+}
+
+}  // namespace
+
+QueryBatch::QueryBatch(size_t max_packet_size) : message_(max_packet_size) {}
+
+bool QueryBatch::add(const std::string &name, std::uint16_t rtype, const std::vector<QueryRecord> &known_answers) {
+  FoldedName folded;
+  if (!foldName(name, folded)) {
+    return false;
+  }
+  Question question;
+  question.name = wireName(name);
+  question.rtype = rtype;
+  question.first_known = num_known_;
+  question.num_known = known_answers.size();
+  for (const QueryRecord &record : known_answers) {
+    if (num_known_ == known_.size()) {
+      known_.push_back(record);
+    } else {
+      known_[num_known_] = record;
+    }
+    ++num_known_;
+  }
+  // "_http._tcp.local." sorts as "local" "_tcp" "_http"
+  std::vector<size_t> labels;
+  for (size_t offset = 0; folded.data[offset]; offset += 1 + folded.data[offset]) {
+    labels.push_back(offset);
+  }
+  for (auto it = labels.rbegin(); it != labels.rend(); ++it) {
+    question.reversed.append(reinterpret_cast<const char *>(folded.data + *it), 1 + folded.data[*it]);
+  }
+  questions_.push_back(std::move(question));
+  sorted_ = false;
+  built_ = false;
+  return true;
+}
+
+void QueryBatch::clear() {
+  questions_.clear();
+  num_known_ = 0;
+  sorted_ = true;
+  built_ = false;
+}
+
+void QueryBatch::build(std::uint16_t query_id, bool unicast) {
+  if (built_ && built_unicast_ == unicast && built_query_id_ == query_id) {
+    return;
+  }
+  if (!sorted_) {
+    const auto less = [](const Question &lhs, const Question &rhs) {
+      return (lhs.reversed != rhs.reversed) ? (lhs.reversed < rhs.reversed) : (lhs.rtype < rhs.rtype);
+    };
+    const auto same = [](const Question &lhs, const Question &rhs) {
+      return lhs.rtype == rhs.rtype && lhs.reversed == rhs.reversed;
+    };
+    std::sort(questions_.begin(), questions_.end(), less);
+    questions_.erase(std::unique(questions_.begin(), questions_.end(), same), questions_.end());
+    sorted_ = true;
+  }
+
+  const std::uint16_t rclass = MDNS_CLASS_IN | (unicast ? MDNS_UNICAST_RESPONSE : 0);
+  message_.begin(query_id, 0);
+  size_t iquestion = 0;
+  while (iquestion < questions_.size()) {
+    // Every packet of questions starts a new query, the known answers of the one before are complete
+    message_.next();
+    PacketWriter &writer = message_.writer();
+    const size_t first = iquestion;
+    while (iquestion < questions_.size() &&
+           writer.addQuestion(questions_[iquestion].name, questions_[iquestion].rtype, rclass)) {
+      ++iquestion;
+    }
+    if (iquestion == first) {
+      // A single question larger than a packet, which max_name_length rules out for any MTU
+      break;
+    }
+
+    for (size_t ianswered = first; ianswered < iquestion; ++ianswered) {
+      const Question &question = questions_[ianswered];
+      for (size_t iknown = 0; iknown < question.num_known; ++iknown) {
+        const QueryRecord &record = known_[question.first_known + iknown];
+        // A record too large for an empty packet is left out
+        message_.add([&](PacketWriter &packet) { return writeKnownAnswer(packet, record); }, true);
+      }
+    }
+  }
+
+  built_ = true;
+  built_unicast_ = unicast;
+  built_query_id_ = query_id;
+}
+
+int QueryBatch::send(const mdns_socket_info_t &socket, std::uint16_t query_id) {
+  build(query_id, socket.unicast_response != 0);
+  int sent = 0;
+  for (size_t ipacket = 0; ipacket < message_.packets(); ++ipacket) {
+    if (mdns_multicast_send_info(&socket, message_.data(ipacket), message_.size(ipacket))) {
+      return -1;
+    }
+    ++sent;
+  }
+  return sent;
+}
+
+}  // namespace mdns_cpp
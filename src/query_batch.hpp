@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mdns.h"
+#include "mdns_cpp/defs.hpp"
+#include "message_builder.hpp"
+
+namespace mdns_cpp {
+
+// Packs the questions of many queries into as few packets as possible.
+//
+// Questions are sorted so names sharing a parent domain end up next to each other and compress against each other,
+// then each packet is filled up to the maximum packet size. Responders answer all questions of a packet at once, so
+// resolving 50 instances costs a handful of packets on both sides instead of 50.
+//
+// Each question can carry the records the querier already holds, which are written to the answer section so
+// responders do not send them again (RFC 6762 section 7.1). Known answers that do not fit continue in packets without
+// questions, all but the last with the TC bit set (section 7.2).
+class QueryBatch {
+ public:
+  explicit QueryBatch(size_t max_packet_size = MessageBuilder::default_mtu);
+
+  // Adds a question for the records of type rtype named name, with the records of known_answers as its known answers.
+  // Duplicates are dropped. Returns false if name is not a valid domain name.
+  bool add(const std::string &name, std::uint16_t rtype, const std::vector<QueryRecord> &known_answers = {});
+
+  bool empty() const { return questions_.empty(); }
+  size_t size() const { return questions_.size(); }
+  void clear();
+
+  // Sends the questions multicast on socket, asking for unicast responses if the socket is not bound to the mDNS port.
+  // Returns the number of packets sent, or <0 if a packet could not be sent.
+  int send(const mdns_socket_info_t &socket, std::uint16_t query_id);
+
+ private:
+  struct Question {
+    // Labels in reverse order, the sort key
+    std::string reversed;
+    std::string name;
+    std::uint16_t rtype{0};
+    // Range of the known answers in known_
+    size_t first_known{0};
+    size_t num_known{0};
+  };
+
+  // Serializes the questions into message_, unless they are already built with the same response mode
+  void build(std::uint16_t query_id, bool unicast);
+
+  std::vector<Question> questions_;
+  // Kept with their strings across batches, so refilling them does not allocate
+  std::vector<QueryRecord> known_;
+  size_t num_known_{0};
+  bool sorted_{true};
+  MessageBuilder message_;
+  bool built_{false};
+  bool built_unicast_{false};
+  std::uint16_t built_query_id_{0};
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,782 @@
+#include "query_engine.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "mdns_cpp/macros.hpp"
+#include "record_decoder.hpp"
+
+namespace mdns_cpp {
+
+namespace {
+
+// Query intervals of a browse (RFC 6762 section 5.2)
+constexpr std::chrono::seconds initial_browse_interval{1};
+constexpr std::chrono::minutes max_browse_interval{60};
+// Refresh queries for an observed record are sent at 80, 85, 90 and 95% of its TTL plus up to 2%
+constexpr unsigned int refresh_points = 4;
+// How long goodbye records and records flushed by the cache-flush bit stay (RFC 6762 section 10.2)
+constexpr std::chrono::seconds flush_delay{1};
+
+}  // namespace
+
+QueryEngine::QueryEngine(size_t batch_size, size_t max_packet_size, std::shared_ptr<RecordCache> cache,
+                         std::shared_ptr<LatencyEstimator> latency)
+    : receiver_(batch_size),
+      cache_(std::move(cache)),
+      latency_(std::move(latency)),
+      batch_(max_packet_size),
+      requeries_(max_packet_size),
+      random_(std::random_device{}()) {
+  sockets_.refresh(true);
+  if (sockets_.sockets().empty()) {
+    const auto msg = "Failed to open any client sockets";
+    MDNS_LOG << msg << "\n";
+    throw std::runtime_error(msg);
+  }
+  MDNS_LOG << "Opened " << sockets_.sockets().size() << " sockets for mDNS queries\n";
+
+  for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+    reactor_.add(socket.sock);
+  }
+  if (sockets_.changeDescriptor() >= 0) {
+    reactor_.add(sockets_.changeDescriptor());
+  } else {
+    wheel_.schedule(Clock::now() + ClientSocketPool::rescan_interval, [this]() { refreshSockets(); });
+  }
+  ready_.resize(sockets_.sockets().size() + 1);
+  thread_ = std::thread([this]() { run(); });
+}
+
+QueryEngine::~QueryEngine() {
+  stop();
+  for (const mdns_socket_info_t &socket : listen_sockets_) {
+    mdns_socket_close(socket.sock);
+  }
+}
+
+QueryId QueryEngine::submit(const std::string &name, std::uint16_t rtype, RecordCallback on_record,
+                            QueryDoneCallback on_done, const QueryPolicy &policy) {
+  auto query = std::make_unique<Query>();
+  query->name = name;
+  foldName(name, query->folded);
+  query->rtype = rtype;
+  query->on_record = std::move(on_record);
+  query->on_done = std::move(on_done);
+  query->policy = policy;
+  return enqueue(std::move(query));
+}
+
+QueryId QueryEngine::browse(const std::string &name, std::uint16_t rtype, BrowseCallback on_event,
+                            QueryDoneCallback on_done) {
+  auto query = std::make_unique<Query>();
+  query->name = name;
+  foldName(name, query->folded);
+  query->rtype = rtype;
+  query->on_event = std::move(on_event);
+  query->on_done = std::move(on_done);
+  return enqueue(std::move(query));
+}
+
+QueryId QueryEngine::resolve(const std::string &name, ResolveCallback on_resolved, QueryDoneCallback on_done,
+                             const QueryPolicy &policy) {
+  auto query = std::make_unique<Query>();
+  query->name = name;
+  foldName(name, query->folded);
+  query->rtype = MDNS_RECORDTYPE_PTR;
+  query->on_resolved = std::move(on_resolved);
+  query->on_done = std::move(on_done);
+  query->policy = policy;
+  query->resolution = std::make_unique<Resolution>(query->folded);
+  return enqueue(std::move(query));
+}
+
+QueryId QueryEngine::enqueue(std::unique_ptr<Query> query) {
+  QueryId id = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return 0;
+    }
+    id = next_id_++;
+    query->id = id;
+    active_.emplace(id, query.get());
+    submitted_.push_back(std::move(query));
+  }
+  reactor_.wakeup();
+  return id;
+}
+
+bool QueryEngine::cancel(QueryId id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = active_.find(id);
+    if (it == active_.end()) {
+      return false;
+    }
+    // No further record may reach the query, it ends with the next round of commands
+    it->second->cancelled = true;
+    active_.erase(it);
+    cancelled_.push_back(id);
+  }
+  reactor_.wakeup();
+  return true;
+}
+
+void QueryEngine::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  reactor_.wakeup();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void QueryEngine::run() {
+  while (processCommands()) {
+    sendBatch();
+    const int num_ready = reactor_.wait(ready_.data(), static_cast<int>(ready_.size()), wheel_.timeout(Clock::now()));
+    if (num_ready < 0) {
+      MDNS_LOG << "Failed to wait for mDNS query responses: " << strerror(errno) << "\n";
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      continue;
+    }
+
+    bool interfaces_changed = false;
+    for (int iready = 0; iready < num_ready; ++iready) {
+      const int sock = ready_[iready];
+      if (sock == sockets_.changeDescriptor()) {
+        interfaces_changed = true;
+        continue;
+      }
+      const auto &sockets = sockets_.sockets();
+      const auto socket = std::find_if(sockets.begin(), sockets.end(),
+                                       [&](const mdns_socket_info_t &info) { return info.sock == sock; });
+      interface_index_ = (socket != sockets.end()) ? socket->interface_index : 0;
+      const bool listening = (socket == sockets.end());
+      const size_t received = receiver_.receive(sock);
+      received_at_ = Clock::now();
+      for (size_t ipacket = 0; ipacket < received; ++ipacket) {
+        const PacketView packet(receiver_.data(ipacket), receiver_.size(ipacket));
+        // The mDNS port also carries the queries of other hosts, whose known answers are no news
+        if ((listening && !packet.isResponse()) || !index_.build(packet.data(), packet.size())) {
+          continue;
+        }
+        packet_answered_.clear();
+        for (size_t irecord = 0; irecord < index_.recordCount(); ++irecord) {
+          const RecordView record = index_.record(irecord);
+          if (record.section() != RecordSection::Authority) {
+            dispatch(packet.id(), record);
+          }
+        }
+        endPacket();
+      }
+    }
+    if (interfaces_changed) {
+      refreshSockets();
+    }
+
+    wheel_.advance(Clock::now());
+  }
+}
+
+bool QueryEngine::answerFromCache(std::unique_ptr<Query> &query) {
+  cached_.clear();
+  if (!cache_->answer(query->folded, query->rtype, Clock::now(), cached_)) {
+    return false;
+  }
+  // Registered like a sent query, so the callbacks can cancel it
+  Query &answered = *query;
+  queries_.emplace(answered.id, std::move(query));
+  for (const QueryRecord &record : cached_) {
+    if (answered.cancelled) {
+      break;
+    }
+    if (answered.on_record) {
+      answered.on_record(record);
+    }
+  }
+  finish(answered.id, QueryStatus::Completed);
+  return true;
+}
+
+bool QueryEngine::processCommands() {
+  std::vector<std::unique_ptr<Query>> submitted;
+  std::vector<QueryId> cancelled;
+  bool stopping = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitted.swap(submitted_);
+    cancelled.swap(cancelled_);
+    stopping = stopping_;
+  }
+
+  for (auto &query : submitted) {
+    if (query->cancelled || stopping) {
+      // Never sent, so there is nothing to clean up
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_.erase(query->id);
+      }
+      if (query->on_done) {
+        query->on_done(QueryStatus::Cancelled);
+      }
+    } else {
+      start(std::move(query));
+    }
+  }
+  for (const QueryId id : cancelled) {
+    finish(id, QueryStatus::Cancelled);
+  }
+
+  if (stopping) {
+    while (!queries_.empty()) {
+      finish(queries_.begin()->first, QueryStatus::Cancelled);
+    }
+    return false;
+  }
+  return true;
+}
+
+void QueryEngine::refreshSockets() {
+  const bool notified = sockets_.changeDescriptor() >= 0;
+  // refresh() may close sockets and open new ones with the same descriptors, so all are registered anew
+  for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+    reactor_.remove(socket.sock);
+  }
+  const bool changed = sockets_.refresh(!notified);
+  if (changed) {
+    MDNS_LOG << "Interfaces changed, using " << sockets_.sockets().size() << " sockets for mDNS queries\n";
+  }
+  for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+    reactor_.add(socket.sock);
+  }
+  ready_.resize(sockets_.sockets().size() + listen_sockets_.size() + 1);
+
+  if (changed) {
+    joinInterfaces();
+    // Hosts on a new network are not known yet, browses start over with short intervals and a first query asking for
+    // unicast responses (RFC 6762 section 5.4)
+    const auto now = Clock::now();
+    for (auto &entry : queries_) {
+      Query &query = *entry.second;
+      if (query.on_event) {
+        wheel_.cancel(query.timer);
+        queue(batch_, query.name, query.folded, query.rtype);
+        query.last_sent = now;
+        query.interval = initial_browse_interval;
+        const QueryId id = query.id;
+        query.timer = wheel_.schedule(now + query.interval, [this, id]() { requery(id); });
+      }
+    }
+  }
+  if (!notified) {
+    wheel_.schedule(Clock::now() + ClientSocketPool::rescan_interval, [this]() { refreshSockets(); });
+  }
+}
+
+void QueryEngine::start(std::unique_ptr<Query> query) {
+  const bool browse = static_cast<bool>(query->on_event);
+  if (!browse && !query->resolution && answerFromCache(query)) {
+    return;
+  }
+
+  const QueryId id = query->id;
+  const auto now = Clock::now();
+  Query &started = *query;
+  by_name_.emplace(query->folded.hash, id);
+  queries_.emplace(id, std::move(query));
+
+  if (started.resolution) {
+    // The PTR records the cache holds come with what it holds on the instances, only the rest is asked for
+    cached_.clear();
+    if (cache_->answer(started.folded, started.rtype, now, cached_)) {
+      for (const QueryRecord &record : cached_) {
+        started.resolution->add(record);
+      }
+      report(started, false);
+      nextRound(started);
+      return;
+    }
+  }
+  queue(batch_, started.name, started.folded, started.rtype);
+  batched_.push_back(id);
+
+  if (!browse) {
+    arm(started, now);
+    return;
+  }
+  openListenSockets();
+  started.last_sent = now;
+  started.interval = initial_browse_interval;
+  started.timer = wheel_.schedule(now + started.interval, [this, id]() { requery(id); });
+
+  // What the cache already holds is reported at once
+  cached_.clear();
+  const size_t answers = cache_->answer(started.folded, started.rtype, now, cached_);
+  for (size_t ianswer = 0; ianswer < answers && !started.cancelled; ++ianswer) {
+    record_ = cached_[ianswer];
+    observe(started, MDNS_CLASS_IN, now);
+  }
+}
+
+void QueryEngine::queue(QueryBatch &batch, const std::string &name, const FoldedName &folded, std::uint16_t rtype) {
+  known_answers_.clear();
+  cache_->knownAnswers(folded, rtype, Clock::now(), known_answers_);
+  batch.add(name, rtype, known_answers_);
+}
+
+void QueryEngine::arm(Query &query, Clock::time_point now) {
+  const QueryId id = query.id;
+  if (query.policy.timeout.count() > 0) {
+    query.timer = wheel_.schedule(now + query.policy.timeout, [this, id]() { complete(id); });
+  }
+  query.quiet_period = query.policy.adaptive ? latency_->quietPeriod(query.policy.quiet_period)
+                                             : Clock::duration(query.policy.quiet_period);
+}
+
+void QueryEngine::complete(QueryId id) {
+  const auto it = queries_.find(id);
+  if (it == queries_.end()) {
+    return;
+  }
+  if (it->second->resolution) {
+    nextRound(*it->second);
+  } else {
+    finish(id, QueryStatus::Completed);
+  }
+}
+
+void QueryEngine::nextRound(Query &resolve) {
+  wheel_.cancel(resolve.timer);
+  wheel_.cancel(resolve.quiet_timer);
+  resolve.quiet_timer = 0;
+  releaseTransaction(resolve);
+
+  questions_.clear();
+  if (resolve.cancelled || !resolve.resolution->followUps(questions_)) {
+    report(resolve, true);
+    finish(resolve.id, QueryStatus::Completed);
+    return;
+  }
+  for (const Resolution::Question &question : questions_) {
+    queue(batch_, question.name, question.folded, question.rtype);
+  }
+  batched_.push_back(resolve.id);
+  resolve.answers = 0;
+  arm(resolve, Clock::now());
+}
+
+void QueryEngine::report(Query &resolve, bool final) {
+  resolved_.clear();
+  resolve.resolution->takeResolved(resolved_, final);
+  for (const ResolvedService &service : resolved_) {
+    if (resolve.cancelled) {
+      break;
+    }
+    if (resolve.on_resolved) {
+      resolve.on_resolved(service);
+    }
+  }
+}
+
+void QueryEngine::endPacket() {
+  for (const QueryId id : packet_queries_) {
+    const auto it = queries_.find(id);
+    if (it == queries_.end()) {
+      continue;
+    }
+    Query &query = *it->second;
+    if (query.resolution) {
+      report(query, false);
+    }
+    const bool satisfied = query.policy.max_answers && query.answers >= query.policy.max_answers;
+    if (satisfied || (query.resolution && query.resolution->followingUp() && query.resolution->complete())) {
+      complete(id);
+    }
+  }
+  packet_queries_.clear();
+}
+
+void QueryEngine::sendRequeries() {
+  if (requeries_.empty()) {
+    return;
+  }
+  for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+    const auto listen = std::find_if(listen_sockets_.begin(), listen_sockets_.end(),
+                                     [&](const mdns_socket_info_t &info) { return info.family == socket.family; });
+    // Without a listen socket of the family the questions go out like first queries
+    if (listen != listen_sockets_.end() && sendOnInterface(*listen, socket)) {
+      requeries_.send(*listen, 0);
+    } else {
+      requeries_.send(socket, 0);
+    }
+  }
+  requeries_.clear();
+}
+
+void QueryEngine::sendBatch() {
+  sendRequeries();
+  if (batch_.empty()) {
+    return;
+  }
+  // The one-shot queries of a batch share a transaction ID, browses match the responses by name
+  const bool one_shots = std::any_of(batched_.begin(), batched_.end(), [&](QueryId id) {
+    const auto it = queries_.find(id);
+    return it != queries_.end() && !it->second->on_event;
+  });
+  const std::uint16_t transaction_id = one_shots ? allocateTransactionId() : 0;
+
+  size_t sent = 0;
+  for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+    if (batch_.send(socket, transaction_id) > 0) {
+      ++sent;
+    }
+  }
+  batch_.clear();
+
+  const auto now = Clock::now();
+  std::vector<QueryId> batched;
+  batched.swap(batched_);
+  for (const QueryId id : batched) {
+    const auto it = queries_.find(id);
+    if (it == queries_.end()) {
+      continue;
+    }
+    Query &query = *it->second;
+    if (!sent) {
+      finish(id, QueryStatus::Failed);
+      continue;
+    }
+    if (query.on_event) {
+      continue;
+    }
+    if (transaction_id) {
+      query.transaction_id = transaction_id;
+      by_transaction_[transaction_id].push_back(id);
+    }
+    query.sent = now;
+    query.last_received = now;
+    if (query.quiet_period.count() > 0) {
+      query.quiet_timer = wheel_.schedule(now + query.quiet_period, [this, id]() { complete(id); });
+    }
+  }
+}
+
+void QueryEngine::requery(QueryId id) {
+  const auto it = queries_.find(id);
+  if (it == queries_.end()) {
+    return;
+  }
+  Query &browse = *it->second;
+  const auto now = Clock::now();
+  queue(requeries_, browse.name, browse.folded, browse.rtype);
+  browse.last_sent = now;
+  browse.interval = std::min<Clock::duration>(browse.interval * 2, max_browse_interval);
+  browse.timer = wheel_.schedule(now + browse.interval, [this, id]() { requery(id); });
+}
+
+void QueryEngine::scheduleRefresh(Query &browse, std::uint64_t identity, Observed &observed) {
+  // Per mille of the TTL
+  std::uint64_t point = 1000;
+  if (observed.refreshes < refresh_points) {
+    point = 800 + 50 * observed.refreshes + random_() % 21;
+  }
+  const QueryId id = browse.id;
+  wheel_.cancel(observed.timer);
+  observed.timer = wheel_.schedule(observed.received + std::chrono::milliseconds(observed.record.ttl * point),
+                                   [this, id, identity]() { refresh(id, identity); });
+}
+
+void QueryEngine::expireSoon(Query &browse, std::uint64_t identity, Observed &observed, Clock::time_point now) {
+  // Removed unless received again in the meantime
+  const QueryId id = browse.id;
+  observed.refreshes = refresh_points;
+  wheel_.cancel(observed.timer);
+  observed.timer = wheel_.schedule(now + flush_delay, [this, id, identity]() { refresh(id, identity); });
+}
+
+void QueryEngine::refresh(QueryId id, std::uint64_t identity) {
+  const auto query_it = queries_.find(id);
+  if (query_it == queries_.end()) {
+    return;
+  }
+  Query &browse = *query_it->second;
+  const auto it = browse.observed.find(identity);
+  if (it == browse.observed.end()) {
+    return;
+  }
+  Observed &observed = it->second;
+
+  if (observed.refreshes >= refresh_points) {
+    QueryRecord record = std::move(observed.record);
+    browse.observed.erase(it);
+    record.ttl = 0;
+    if (!browse.cancelled) {
+      browse.on_event(BrowseEvent::Removed, record);
+    }
+    return;
+  }
+  // Records expiring together share their refresh query
+  const auto now = Clock::now();
+  if (now - browse.last_sent >= initial_browse_interval) {
+    queue(requeries_, browse.name, browse.folded, browse.rtype);
+    browse.last_sent = now;
+  }
+  ++observed.refreshes;
+  scheduleRefresh(browse, identity, observed);
+}
+
+void QueryEngine::observe(Query &browse, std::uint16_t rclass, Clock::time_point now) {
+  const std::uint64_t data_hash = recordDataHash(record_);
+  // A name holds a single SRV and TXT record, whose data can change, and any number of PTR and address records
+  const bool single = record_.type == MDNS_RECORDTYPE_SRV || record_.type == MDNS_RECORDTYPE_TXT;
+  const std::uint64_t identity = mixHash(record_.type, single ? 0 : data_hash);
+
+  if (rclass & MDNS_CACHE_FLUSH) {
+    for (auto &entry : browse.observed) {
+      Observed &other = entry.second;
+      if (entry.first != identity && other.record.type == record_.type && other.refreshes < refresh_points &&
+          now - other.received > flush_delay) {
+        expireSoon(browse, entry.first, other, now);
+      }
+    }
+  }
+
+  auto it = browse.observed.find(identity);
+  if (!record_.ttl) {
+    if (it != browse.observed.end()) {
+      expireSoon(browse, identity, it->second, now);
+    }
+    return;
+  }
+
+  BrowseEvent event = BrowseEvent::Added;
+  if (it == browse.observed.end()) {
+    it = browse.observed.emplace(identity, Observed()).first;
+  } else if (it->second.data_hash != data_hash) {
+    event = BrowseEvent::Updated;
+  } else {
+    // Known already, only its TTL is refreshed
+    it->second.record.ttl = record_.ttl;
+    it->second.received = now;
+    it->second.refreshes = 0;
+    scheduleRefresh(browse, identity, it->second);
+    return;
+  }
+  Observed &observed = it->second;
+  observed.record = record_;
+  observed.data_hash = data_hash;
+  observed.received = now;
+  observed.refreshes = 0;
+  scheduleRefresh(browse, identity, observed);
+  browse.on_event(event, observed.record);
+}
+
+void QueryEngine::openListenSockets() {
+  if (!listen_sockets_.empty()) {
+    return;
+  }
+  sockaddr_in addr_ipv4{};
+  addr_ipv4.sin_family = AF_INET;
+  addr_ipv4.sin_port = htons(MDNS_PORT);
+#ifdef __APPLE__
+  addr_ipv4.sin_len = sizeof(sockaddr_in);
+#endif
+  mdns_socket_info_t info;
+  const int sock_ipv4 = mdns_socket_open_ipv4(&addr_ipv4);
+  if (sock_ipv4 >= 0 && !mdns_socket_describe(sock_ipv4, 0, &info)) {
+    listen_sockets_.push_back(info);
+  } else if (sock_ipv4 >= 0) {
+    mdns_socket_close(sock_ipv4);
+  }
+  sockaddr_in6 addr_ipv6{};
+  addr_ipv6.sin6_family = AF_INET6;
+  addr_ipv6.sin6_addr = in6addr_any;
+  addr_ipv6.sin6_port = htons(MDNS_PORT);
+#ifdef __APPLE__
+  addr_ipv6.sin6_len = sizeof(sockaddr_in6);
+#endif
+  const int sock_ipv6 = mdns_socket_open_ipv6(&addr_ipv6);
+  if (sock_ipv6 >= 0 && !mdns_socket_describe(sock_ipv6, 0, &info)) {
+    listen_sockets_.push_back(info);
+  } else if (sock_ipv6 >= 0) {
+    mdns_socket_close(sock_ipv6);
+  }
+  if (listen_sockets_.empty()) {
+    MDNS_LOG << "Failed to listen on the mDNS port, browses only see responses to their queries\n";
+  }
+
+  for (const mdns_socket_info_t &socket : listen_sockets_) {
+    reactor_.add(socket.sock);
+  }
+  ready_.resize(sockets_.sockets().size() + listen_sockets_.size() + 1);
+  joinInterfaces();
+}
+
+void QueryEngine::joinInterfaces() {
+  for (const mdns_socket_info_t &listen : listen_sockets_) {
+    for (const mdns_socket_info_t &socket : sockets_.sockets()) {
+      if (socket.family == listen.family) {
+        joinInterface(listen, socket);
+      }
+    }
+  }
+}
+
+void QueryEngine::finish(QueryId id, QueryStatus status) {
+  const auto it = queries_.find(id);
+  if (it == queries_.end()) {
+    return;
+  }
+  std::unique_ptr<Query> query = std::move(it->second);
+  queries_.erase(it);
+
+  wheel_.cancel(query->timer);
+  wheel_.cancel(query->quiet_timer);
+  for (const auto &entry : query->observed) {
+    wheel_.cancel(entry.second.timer);
+  }
+  releaseTransaction(*query);
+  const auto range = by_name_.equal_range(query->folded.hash);
+  for (auto name_it = range.first; name_it != range.second; ++name_it) {
+    if (name_it->second == id) {
+      by_name_.erase(name_it);
+      break;
+    }
+  }
+  bool cancelled = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled = !active_.erase(id);
+  }
+
+  if (query->on_done) {
+    // A query cancelled by another thread or one of its callbacks may reach its end before the cancellation is
+    // processed
+    query->on_done(cancelled ? QueryStatus::Cancelled : status);
+  }
+}
+
+void QueryEngine::releaseTransaction(Query &query) {
+  if (!query.transaction_id) {
+    return;
+  }
+  auto &batch = by_transaction_[query.transaction_id];
+  batch.erase(std::find(batch.begin(), batch.end(), query.id));
+  if (batch.empty()) {
+    by_transaction_.erase(query.transaction_id);
+  }
+  query.transaction_id = 0;
+}
+
+std::uint16_t QueryEngine::allocateTransactionId() {
+  // IDs are handed out in turn, so a late response rarely reaches a newer query reusing the ID
+  for (size_t attempt = 0; attempt < 0x10000; ++attempt) {
+    if (++next_transaction_ && !by_transaction_.count(next_transaction_)) {
+      return next_transaction_;
+    }
+  }
+  // All IDs in use, the responses are matched by name
+  return 0;
+}
+
+void QueryEngine::dispatch(std::uint16_t transaction_id, const RecordView &record) {
+  if (!decodeRecord(record, record_)) {
+    return;
+  }
+  const std::uint16_t rtype = record.type();
+  const std::uint16_t rclass = record.rclass();
+  record_.interface_index = interface_index_;
+  cache_->insert(record_, rclass, received_at_);
+
+  matches_.clear();
+  bool folded = false;
+  const auto asks = [&](const Query &query) {
+    if (query.resolution) {
+      return query.resolution->wants(record_name_, rtype);
+    }
+    return (query.rtype == rtype || query.rtype == MDNS_RECORDTYPE_ANY) && query.folded == record_name_;
+  };
+  if (transaction_id) {
+    const auto it = by_transaction_.find(transaction_id);
+    if (it != by_transaction_.end() && it->second.size() == 1) {
+      // A response to a query of our own, everything in it is meant for that query
+      matches_.push_back(it->second.front());
+    } else if (it != by_transaction_.end() && (folded = record.name().fold(record_name_))) {
+      // A response to a batch: answers go to the queries asking for them, other records to the queries answered
+      // earlier in the same packet, which they usually belong to
+      for (const QueryId id : it->second) {
+        if (asks(*queries_.at(id))) {
+          matches_.push_back(id);
+          packet_answered_.push_back(id);
+        } else if (std::find(packet_answered_.begin(), packet_answered_.end(), id) != packet_answered_.end()) {
+          matches_.push_back(id);
+        }
+      }
+    }
+  }
+  // Multicast answers and the answers for browses go to every query asking for them
+  if (!by_name_.empty() && (folded || record.name().fold(record_name_))) {
+    const auto range = by_name_.equal_range(record_name_.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (asks(*queries_.at(it->second)) &&
+          std::find(matches_.begin(), matches_.end(), it->second) == matches_.end()) {
+        matches_.push_back(it->second);
+      }
+    }
+  }
+
+  // Callbacks may cancel queries and policies end them, so each one is looked up again
+  for (const QueryId id : matches_) {
+    const auto it = queries_.find(id);
+    if (it == queries_.end() || it->second->cancelled) {
+      continue;
+    }
+    Query &query = *it->second;
+    if (query.on_event) {
+      observe(query, rclass, received_at_);
+      continue;
+    }
+    if (query.resolution) {
+      query.resolution->add(record_);
+      if (std::find(packet_queries_.begin(), packet_queries_.end(), id) == packet_queries_.end()) {
+        packet_queries_.push_back(id);
+      }
+    } else if (query.on_record) {
+      query.on_record(record_);
+    }
+    // The answers to the follow-up questions of a resolve are not counted, a round ends once all instances resolved
+    if (!folded && query.policy.max_answers) {
+      folded = record.name().fold(record_name_);
+    }
+    account(query, query.policy.max_answers && folded && asks(query) &&
+                       !(query.resolution && query.resolution->followingUp()));
+  }
+}
+
+void QueryEngine::account(Query &query, bool answer) {
+  if (received_at_ != query.last_received) {
+    // The first record of a response, which restarts the quiet period
+    latency_->sample(received_at_ - query.last_received);
+    query.last_received = received_at_;
+    if (query.quiet_timer) {
+      wheel_.cancel(query.quiet_timer);
+      const QueryId id = query.id;
+      query.quiet_timer =
+          wheel_.schedule(received_at_ + query.quiet_period, [this, id]() { complete(id); });
+    }
+  }
+  // The rest of the response, such as its additional records, still reaches the query
+  if (answer && ++query.answers == query.policy.max_answers &&
+      std::find(packet_queries_.begin(), packet_queries_.end(), query.id) == packet_queries_.end()) {
+    packet_queries_.push_back(query.id);
+  }
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "batch_receiver.hpp"
+#include "client_socket_pool.hpp"
+#include "dns_name.hpp"
+#include "latency_estimator.hpp"
+#include "mdns.h"
+#include "mdns_cpp/defs.hpp"
+#include "packet_index.hpp"
+#include "query_batch.hpp"
+#include "reactor.hpp"
+#include "record_cache.hpp"
+#include "resolution.hpp"
+#include "timer_wheel.hpp"
+
+namespace mdns_cpp {
+
+// Runs any number of concurrent one-shot queries on a thread of its own.
+//
+// Queries are sent on all client sockets and ask for unicast responses, so the responses come back to these sockets.
+// The questions due in the same round (queries submitted together, browse refreshes expiring together) are packed into
+// as few packets as possible, and the one-shot queries among them share a transaction ID. Records of a response with a
+// known ID go to the queries of that batch, all records go to every query asking for their name and type. The records
+// the cache holds with more than half of their TTL left are sent along as known answers. Deadlines
+// live on a timer wheel, so a single thread can wait on hundreds of queries. The sockets stay open for the lifetime of
+// the engine and follow the interfaces as they come and go.
+//
+// A one-shot query ends as its QueryPolicy says: at its timeout, with its last answer, or once no record reached it for
+// its quiet period. The gaps between the responses to each query feed the latency estimator the adaptive quiet periods
+// are taken from.
+//
+// A resolve is a one-shot PTR query that goes on with follow-up rounds. Every record reaching it is harvested into its
+// Resolution, and an instance is reported as soon as the response completing it was read. When the policy ends a
+// round, the questions for the pieces still missing are sent as the next round under the same policy; once all
+// instances are resolved the round ends at once.
+//
+// Every record received goes to the record cache. A query the cache holds fresh answers for is answered from it and
+// completes without being sent.
+//
+// Browses are queries without a timeout (RFC 6762 section 5.2). They are sent again after 1, 2, 4... seconds up to an
+// hour, and the records they reported are queried for again at 80, 85, 90 and 95% of their TTL and removed when it
+// runs out. Once the first browse starts the engine also listens on the mDNS port, so announcements and goodbyes of
+// other hosts reach the browses as they are sent. Only the first query of a browse asks for unicast responses, the
+// queries sent again go out from the mDNS port on the interface of each client socket and ask for multicast responses
+// (RFC 6762 section 5.4), which other queriers on the link see as well.
+//
+// submit() and cancel() may be called from any thread, including from the callbacks, which run on the query thread.
+class QueryEngine {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Opens the client sockets and starts the query thread, which sends packets of at most max_packet_size bytes. Throws
+  // std::runtime_error if no socket could be opened.
+  QueryEngine(size_t batch_size, size_t max_packet_size, std::shared_ptr<RecordCache> cache,
+              std::shared_ptr<LatencyEstimator> latency);
+  ~QueryEngine();
+
+  QueryEngine(const QueryEngine &) = delete;
+  QueryEngine &operator=(const QueryEngine &) = delete;
+
+  // Starts a query for the records of type rtype named name (a valid dotted name). on_done runs exactly once, unless
+  // the engine is stopped before the query was picked up.
+  QueryId submit(const std::string &name, std::uint16_t rtype, RecordCallback on_record, QueryDoneCallback on_done,
+                 const QueryPolicy &policy);
+  // Starts a browse, which reports the records of type rtype named name as they come and go until it is cancelled
+  QueryId browse(const std::string &name, std::uint16_t rtype, BrowseCallback on_event, QueryDoneCallback on_done);
+  // Starts a resolve of the instances of the service type name, reporting each one to on_resolved once complete
+  QueryId resolve(const std::string &name, ResolveCallback on_resolved, QueryDoneCallback on_done,
+                  const QueryPolicy &policy);
+  // Ends a query with QueryStatus::Cancelled. No record is delivered to it afterwards. Returns false if the query
+  // already ended.
+  bool cancel(QueryId id);
+
+  // Cancels every query and joins the query thread, which must not be the calling thread
+  void stop();
+
+ private:
+  // A record reported by a browse
+  struct Observed {
+    QueryRecord record;
+    std::uint64_t data_hash{0};
+    Clock::time_point received{};
+    // Refresh queries sent since the record was last received, refresh_points once it is about to be removed
+    unsigned int refreshes{0};
+    TimerWheel::TimerId timer{0};
+  };
+
+  struct Query {
+    QueryId id{0};
+    std::string name;
+    FoldedName folded;
+    std::uint16_t rtype{0};
+    std::uint16_t transaction_id{0};
+    RecordCallback on_record;
+    QueryDoneCallback on_done;
+    QueryPolicy policy;
+    TimerWheel::TimerId timer{0};
+    // Set by cancel(), under mutex_ but read by the query thread without it
+    std::atomic<bool> cancelled{false};
+
+    // One-shot: the quiet period in effect, the answers received and when the query was sent and last got a record
+    Clock::duration quiet_period{};
+    size_t answers{0};
+    Clock::time_point sent{};
+    Clock::time_point last_received{};
+    TimerWheel::TimerId quiet_timer{0};
+
+    // Set for resolves
+    ResolveCallback on_resolved;
+    std::unique_ptr<Resolution> resolution;
+
+    // Set for browses
+    BrowseCallback on_event;
+    // Browse: delay before the next query
+    Clock::duration interval{};
+    Clock::time_point last_sent{};
+    // Browse: the records reported as added, by identity
+    std::unordered_map<std::uint64_t, Observed> observed;
+  };
+
+  QueryId enqueue(std::unique_ptr<Query> query);
+  void run();
+  // Starts the submitted queries and ends the cancelled ones, returns false once the engine is stopping
+  bool processCommands();
+  void start(std::unique_ptr<Query> query);
+  void finish(QueryId id, QueryStatus status);
+  // Ends a one-shot query when its policy says so. A resolve goes on with its next round instead.
+  void complete(QueryId id);
+  // Schedules the timeout and picks the quiet period of a one-shot query or a round of a resolve
+  void arm(Query &query, Clock::time_point now);
+  void releaseTransaction(Query &query);
+  // Queues the follow-up questions of a resolve, or ends it with the instances left if there are none
+  void nextRound(Query &resolve);
+  // Reports the instances a resolve completed, or once final those lacking only their TXT record
+  void report(Query &resolve, bool final);
+  // Ends the queries satisfied by the packet just read and reports the instances it completed
+  void endPacket();
+  std::uint16_t allocateTransactionId();
+  // Adds a question to batch, with the records the cache holds for it as known answers
+  void queue(QueryBatch &batch, const std::string &name, const FoldedName &folded, std::uint16_t rtype);
+  // Sends the questions queued since the last call in as few packets as possible. The queries sent for the first time
+  // fail if the packets could not be sent on any socket.
+  void sendBatch();
+  // Sends the browse questions queued since the last call from the mDNS port
+  void sendRequeries();
+  // Browse timers: the next query, and the refresh or removal of an observed record
+  void requery(QueryId id);
+  void refresh(QueryId id, std::uint64_t identity);
+  void scheduleRefresh(Query &browse, std::uint64_t identity, Observed &observed);
+  // Removes an observed record after flush_delay, for goodbyes and records flushed by the cache-flush bit
+  void expireSoon(Query &browse, std::uint64_t identity, Observed &observed, Clock::time_point now);
+  // Reports the record in record_ to a browse
+  void observe(Query &browse, std::uint16_t rclass, Clock::time_point now);
+  // Counts a record delivered to a one-shot query against its policy
+  void account(Query &query, bool answer);
+  void openListenSockets();
+  // Has the listen sockets receive the multicasts arriving on the interface of every client socket
+  void joinInterfaces();
+  // Follows changes of the interfaces, called when the pool reports them or rescan_interval passed
+  void refreshSockets();
+  // Delivers the answers the cache holds for a query, returns false if there are none
+  bool answerFromCache(std::unique_ptr<Query> &query);
+  // Hands a received answer or additional record to the queries it is meant for
+  void dispatch(std::uint16_t transaction_id, const RecordView &record);
+
+  ClientSocketPool sockets_;
+  // Bound to the mDNS port for all interfaces once the first browse starts, one per address family
+  std::vector<mdns_socket_info_t> listen_sockets_;
+  Reactor reactor_;
+  BatchReceiver receiver_;
+  std::shared_ptr<RecordCache> cache_;
+  std::shared_ptr<LatencyEstimator> latency_;
+  std::thread thread_;
+
+  // Shared with the callers
+  std::mutex mutex_;
+  bool stopping_{false};
+  QueryId next_id_{1};
+  std::vector<std::unique_ptr<Query>> submitted_;
+  std::vector<QueryId> cancelled_;
+  // Queries submitted and not yet ended or cancelled. A query leaves the map before it is destroyed.
+  std::unordered_map<QueryId, Query *> active_;
+
+  // Owned by the query thread
+  TimerWheel wheel_;
+  std::unordered_map<QueryId, std::unique_ptr<Query>> queries_;
+  // The one-shot queries sent together with each transaction ID
+  std::unordered_map<std::uint16_t, std::vector<QueryId>> by_transaction_;
+  std::unordered_multimap<std::uint64_t, QueryId> by_name_;
+  std::uint16_t next_transaction_{0};
+  std::vector<int> ready_;
+  std::vector<QueryId> matches_;
+  // Questions of the next packets and the queries they are the first questions of
+  QueryBatch batch_;
+  std::vector<QueryId> batched_;
+  // Questions of browses sent again
+  QueryBatch requeries_;
+  // Batch queries answered by the packet being read
+  std::vector<QueryId> packet_answered_;
+  // One-shot queries to look at once the packet is read: the satisfied ones and the resolves
+  std::vector<QueryId> packet_queries_;
+  // Interface of the socket being read, when its packets were received and the index of the packet being read
+  unsigned int interface_index_{0};
+  Clock::time_point received_at_{};
+  PacketIndex index_;
+  QueryRecord record_;
+  FoldedName record_name_;
+  std::vector<QueryRecord> cached_;
+  std::vector<QueryRecord> known_answers_;
+  std::vector<Resolution::Question> questions_;
+  std::vector<ResolvedService> resolved_;
+  std::minstd_rand random_;
+};
+
+}  // namespace mdns_cpp
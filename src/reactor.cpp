@@ -0,0 +1,195 @@
+#include "reactor.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <fcntl.h>
+#include <sys/select.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "mdns_cpp/macros.hpp"
+
+namespace mdns_cpp {
+
+#ifdef __linux__
+
+Reactor::Reactor() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    const auto msg = "Error: Failed to create epoll instance";
+    MDNS_LOG << msg << ": " << strerror(errno) << "\n";
+    throw std::runtime_error(msg);
+  }
+
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0) {
+    close(epoll_fd_);
+    const auto msg = "Error: Failed to create eventfd";
+    MDNS_LOG << msg << ": " << strerror(errno) << "\n";
+    throw std::runtime_error(msg);
+  }
+
+  add(event_fd_);
+}
+
+Reactor::~Reactor() {
+  close(event_fd_);
+  close(epoll_fd_);
+}
+
+void Reactor::add(int sock) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = sock;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &event) < 0) {
+    MDNS_LOG << "Failed to register socket " << sock << " with epoll: " << strerror(errno) << "\n";
+  }
+}
+
+void Reactor::remove(int sock) { epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, sock, nullptr); }
+
+int Reactor::wait(int *ready, int capacity, int timeout_ms) {
+  const int max = std::min(capacity + 1, max_events);
+  const int res = epoll_wait(epoll_fd_, events_, max, timeout_ms);
+  if (res < 0) {
+    return (errno == EINTR) ? 0 : -1;
+  }
+
+  int num_ready = 0;
+  for (int i = 0; i < res; ++i) {
+    if (events_[i].data.fd == event_fd_) {
+      uint64_t value;
+      while (read(event_fd_, &value, sizeof(value)) > 0) {
+      }
+      continue;
+    }
+    if (num_ready < capacity) {
+      ready[num_ready++] = events_[i].data.fd;
+    }
+  }
+  return num_ready;
+}
+
+void Reactor::wakeup() {
+  const uint64_t value = 1;
+  (void)!write(event_fd_, &value, sizeof(value));
+}
+
+#else
+
+Reactor::Reactor() {
+#ifndef _WIN32
+  if (pipe(wakeup_pipe_) < 0) {
+    const auto msg = "Error: Failed to create wakeup pipe";
+    MDNS_LOG << msg << ": " << strerror(errno) << "\n";
+    throw std::runtime_error(msg);
+  }
+  for (const int fd : wakeup_pipe_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+Reactor::~Reactor() {
+#ifndef _WIN32
+  close(wakeup_pipe_[0]);
+  close(wakeup_pipe_[1]);
+#endif
+}
+
+void Reactor::add(int sock) { sockets_.push_back(sock); }
+
+void Reactor::remove(int sock) { sockets_.erase(std::remove(sockets_.begin(), sockets_.end(), sock), sockets_.end()); }
+
+int Reactor::wait(int *ready, int capacity, int timeout_ms) {
+#ifdef _WIN32
+  // select() on Windows only accepts sockets, so wakeup() is polled in slices of at most this many milliseconds
+  constexpr int max_slice_ms = 100;
+#endif
+
+  fd_set readfs;
+  while (true) {
+    int nfds = 0;
+    FD_ZERO(&readfs);
+    for (const int sock : sockets_) {
+      if (sock >= nfds) nfds = sock + 1;
+      FD_SET(sock, &readfs);
+    }
+
+    int slice_ms = timeout_ms;
+#ifdef _WIN32
+    if (woken_.exchange(false)) {
+      return 0;
+    }
+    if (slice_ms < 0 || slice_ms > max_slice_ms) slice_ms = max_slice_ms;
+#else
+    if (wakeup_pipe_[0] >= nfds) nfds = wakeup_pipe_[0] + 1;
+    FD_SET(wakeup_pipe_[0], &readfs);
+#endif
+
+    struct timeval timeout;
+    timeout.tv_sec = slice_ms / 1000;
+    timeout.tv_usec = (slice_ms % 1000) * 1000;
+
+    int res = 0;
+#ifdef _WIN32
+    if (sockets_.empty()) {
+      Sleep(slice_ms);
+    } else {
+      res = select(nfds, &readfs, 0, 0, &timeout);
+    }
+    if (res == 0 && slice_ms != timeout_ms) {
+      if (timeout_ms > 0) timeout_ms -= slice_ms;
+      continue;
+    }
+#else
+    res = select(nfds, &readfs, 0, 0, (slice_ms < 0) ? nullptr : &timeout);
+#endif
+    if (res < 0) {
+      return (errno == EINTR) ? 0 : -1;
+    }
+    break;
+  }
+
+#ifndef _WIN32
+  if (FD_ISSET(wakeup_pipe_[0], &readfs)) {
+    char drain[64];
+    while (read(wakeup_pipe_[0], drain, sizeof(drain)) > 0) {
+    }
+  }
+#endif
+
+  int num_ready = 0;
+  for (const int sock : sockets_) {
+    if (num_ready < capacity && FD_ISSET(sock, &readfs)) {
+      ready[num_ready++] = sock;
+    }
+  }
+  return num_ready;
+}
+
+void Reactor::wakeup() {
+#ifdef _WIN32
+  woken_ = true;
+#else
+  const char value = 1;
+  (void)!write(wakeup_pipe_[1], &value, sizeof(value));
+#endif
+}
+
+#endif
+
+}  // namespace mdns_cpp
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace mdns_cpp {
+
+// Readiness notification for the mDNS sockets.
+//
+// On Linux this is an epoll instance plus an eventfd that another thread can signal to interrupt a blocking wait, so
+// dispatch cost does not depend on the number (or value) of the registered descriptors. Other POSIX systems fall back
+// to select() with a self-pipe for wakeups. On Windows select() cannot wait on a pipe, so waits are sliced into short
+// intervals to bound the latency of wakeup().
+class Reactor {
+ public:
+  Reactor();
+  ~Reactor();
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+
+  void add(int sock);
+  void remove(int sock);
+
+  // Blocks until a registered socket is readable, wakeup() is called or timeout_ms elapses (negative waits forever).
+  // Readable sockets are written to ready. Returns the number of readable sockets, 0 on timeout or wakeup and <0 on
+  // error.
+  int wait(int *ready, int capacity, int timeout_ms);
+
+  // Interrupts a concurrent or the next call to wait(). Safe to call from any thread.
+  void wakeup();
+
+ private:
+#ifdef __linux__
+  static constexpr int max_events = 64;
+
+  int epoll_fd_{-1};
+  int event_fd_{-1};
+  epoll_event events_[max_events]{};
+#else
+  std::vector<int> sockets_;
+#ifdef _WIN32
+  std::atomic<bool> woken_{false};
+#else
+  int wakeup_pipe_[2]{-1, -1};
+#endif
+#endif
+};
+
+}  // namespace mdns_cpp
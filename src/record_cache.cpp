@@ -0,0 +1,254 @@
+#include "record_cache.hpp"
+
+#include <algorithm>
+
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+namespace {
+
+// How long goodbye records and records flushed by the cache-flush bit stay (RFC 6762 sections 10.1 and 10.2)
+constexpr std::chrono::seconds flush_delay{1};
+constexpr unsigned int fresh_percent = 80;
+// A full cache evicts capacity / eviction_share records at once
+constexpr size_t eviction_share = 16;
+
+std::uint64_t setKey(std::uint64_t name_hash, std::uint16_t rtype, std::uint16_t rclass) {
+  return mixHash(name_hash, (static_cast<std::uint32_t>(rtype) << 16) | rclass);
+}
+
+}  // namespace
+
+std::uint64_t recordDataHash(const QueryRecord &record) {
+  FoldedName target;
+  switch (record.type) {
+    case MDNS_RECORDTYPE_PTR:
+      return foldName(record.target, target) ? target.hash : 0;
+    case MDNS_RECORDTYPE_SRV:
+      return mixHash(foldName(record.target, target) ? target.hash : 0,
+                     (static_cast<std::uint64_t>(record.priority) << 32) |
+                         (static_cast<std::uint64_t>(record.weight) << 16) | record.port);
+    case MDNS_RECORDTYPE_A:
+      return hashBytes(&record.address_ipv4, sizeof(record.address_ipv4));
+    case MDNS_RECORDTYPE_AAAA:
+      return hashBytes(record.address_ipv6, sizeof(record.address_ipv6));
+    default:
+      return hashBytes(record.txt.data(), record.txt.size());
+  }
+}
+
+RecordCache::RecordCache(size_t capacity) : capacity_(capacity) {}
+
+RecordCache::RecordSet *RecordCache::find(const FoldedName &name, std::uint16_t rtype, std::uint16_t rclass) {
+  const auto range = sets_.equal_range(setKey(name.hash, rtype, rclass));
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.rtype == rtype && it->second.rclass == rclass && it->second.name == name) {
+      return &it->second;
+    }
+  }
+  return nullptr;
+}
+
+void RecordCache::insert(const QueryRecord &record, std::uint16_t rclass, Clock::time_point now) {
+  FoldedName name;
+  if (!foldName(record.name, name)) {
+    return;
+  }
+  const bool flush = (rclass & MDNS_CACHE_FLUSH) != 0;
+  rclass &= static_cast<std::uint16_t>(~MDNS_CACHE_FLUSH);
+  const std::uint64_t data_hash = recordDataHash(record);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!capacity_) {
+    return;
+  }
+  RecordSet *set = find(name, record.type, rclass);
+  if (!set && !record.ttl) {
+    return;
+  }
+
+  if (set && flush) {
+    // Records of the same set received in the last second may belong to the same response and are kept
+    for (Entry &entry : set->entries) {
+      if (entry.data_hash != data_hash && now - entry.received > flush_delay) {
+        entry.fresh_until = now;
+        entry.expires = std::min(entry.expires, now + flush_delay);
+      }
+    }
+  }
+
+  Entry *entry = nullptr;
+  if (set) {
+    const auto it = std::find_if(set->entries.begin(), set->entries.end(),
+                                 [&](const Entry &cached) { return cached.data_hash == data_hash; });
+    entry = (it != set->entries.end()) ? &*it : nullptr;
+  }
+  if (!entry) {
+    if (!record.ttl) {
+      return;
+    }
+    if (size_ >= capacity_) {
+      if (now - last_purge_ >= flush_delay) {
+        purge(now);
+      }
+      if (size_ >= capacity_) {
+        evict(size_ - capacity_ + std::max<size_t>(capacity_ / eviction_share, 1));
+      }
+      set = find(name, record.type, rclass);
+    }
+    if (!set) {
+      RecordSet added;
+      added.name = name;
+      added.rtype = record.type;
+      added.rclass = rclass;
+      set = &sets_.emplace(setKey(name.hash, record.type, rclass), std::move(added))->second;
+    }
+    set->entries.emplace_back();
+    entry = &set->entries.back();
+    entry->data_hash = data_hash;
+    ++size_;
+  }
+
+  entry->record = record;
+  entry->record.section = RecordSection::Answer;
+  entry->received = now;
+  if (record.ttl) {
+    entry->fresh_until = now + std::chrono::milliseconds(std::uint64_t{record.ttl} * 10 * fresh_percent);
+    entry->expires = now + std::chrono::seconds(record.ttl);
+  } else {
+    entry->fresh_until = now;
+    entry->expires = now + flush_delay;
+  }
+}
+
+size_t RecordCache::collect(const FoldedName &name, std::uint16_t rtype, RecordSection section, Clock::time_point now,
+                            std::vector<QueryRecord> &records, bool half_ttl_left) {
+  RecordSet *set = find(name, rtype, MDNS_CLASS_IN);
+  if (!set) {
+    return 0;
+  }
+  size_t collected = 0;
+  for (const Entry &entry : set->entries) {
+    if (now < entry.fresh_until &&
+        (!half_ttl_left || (entry.expires - now) * 2 > std::chrono::seconds(entry.record.ttl))) {
+      records.push_back(entry.record);
+      QueryRecord &record = records.back();
+      record.section = section;
+      // Rounded up, so a record is never reported with TTL 0 before it expires
+      record.ttl =
+          static_cast<std::uint32_t>(std::chrono::ceil<std::chrono::seconds>(entry.expires - now).count());
+      ++collected;
+    }
+  }
+  return collected;
+}
+
+size_t RecordCache::answer(const FoldedName &name, std::uint16_t rtype, Clock::time_point now,
+                           std::vector<QueryRecord> &records) {
+  if (rtype == MDNS_RECORDTYPE_ANY) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t first = records.size();
+  const size_t answers = collect(name, rtype, RecordSection::Answer, now, records);
+
+  // Records appended while walking the list are visited as well, so SRV records found for PTR targets bring in their
+  // addresses
+  for (size_t irecord = first; answers && irecord < records.size(); ++irecord) {
+    const std::uint16_t type = records[irecord].type;
+    if ((type != MDNS_RECORDTYPE_PTR && type != MDNS_RECORDTYPE_SRV) || !foldName(records[irecord].target, target_)) {
+      continue;
+    }
+    if (type == MDNS_RECORDTYPE_PTR) {
+      collect(target_, MDNS_RECORDTYPE_SRV, RecordSection::Additional, now, records);
+      collect(target_, MDNS_RECORDTYPE_TXT, RecordSection::Additional, now, records);
+    } else {
+      collect(target_, MDNS_RECORDTYPE_A, RecordSection::Additional, now, records);
+      collect(target_, MDNS_RECORDTYPE_AAAA, RecordSection::Additional, now, records);
+    }
+  }
+  return answers;
+}
+
+size_t RecordCache::knownAnswers(const FoldedName &name, std::uint16_t rtype, Clock::time_point now,
+                                 std::vector<QueryRecord> &records) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (rtype != MDNS_RECORDTYPE_ANY) {
+    return collect(name, rtype, RecordSection::Answer, now, records, true);
+  }
+  size_t collected = 0;
+  for (const std::uint16_t type : {MDNS_RECORDTYPE_A, MDNS_RECORDTYPE_PTR, MDNS_RECORDTYPE_TXT, MDNS_RECORDTYPE_AAAA,
+                                   MDNS_RECORDTYPE_SRV}) {
+    collected += collect(name, type, RecordSection::Answer, now, records, true);
+  }
+  return collected;
+}
+
+template <typename Pred>
+void RecordCache::eraseIf(Pred pred) {
+  for (auto it = sets_.begin(); it != sets_.end();) {
+    auto &entries = it->second.entries;
+    const auto end = std::remove_if(entries.begin(), entries.end(), pred);
+    size_ -= static_cast<size_t>(entries.end() - end);
+    entries.erase(end, entries.end());
+    it = entries.empty() ? sets_.erase(it) : std::next(it);
+  }
+}
+
+void RecordCache::purge(Clock::time_point now) {
+  last_purge_ = now;
+  eraseIf([&](const Entry &entry) { return entry.expires <= now; });
+}
+
+void RecordCache::evict(size_t count) {
+  if (count >= size_) {
+    sets_.clear();
+    size_ = 0;
+    return;
+  }
+  if (!count) {
+    return;
+  }
+  // The expiry of the last record to go, and how many of the records expiring exactly then go as well
+  expiries_.clear();
+  for (const auto &set : sets_) {
+    for (const Entry &entry : set.second.entries) {
+      expiries_.push_back(entry.expires);
+    }
+  }
+  std::nth_element(expiries_.begin(), expiries_.begin() + (count - 1), expiries_.end());
+  const Clock::time_point last = expiries_[count - 1];
+  const auto earlier = std::count_if(expiries_.begin(), expiries_.begin() + (count - 1),
+                                     [&](Clock::time_point expires) { return expires < last; });
+  size_t at_last = count - static_cast<size_t>(earlier);
+  eraseIf([&](const Entry &entry) {
+    if (entry.expires == last && at_last) {
+      --at_last;
+      return true;
+    }
+    return entry.expires < last;
+  });
+}
+
+void RecordCache::setCapacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ > capacity) {
+    purge(Clock::now());
+    evict(size_ > capacity ? size_ - capacity : 0);
+  }
+  capacity_ = capacity;
+}
+
+size_t RecordCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void RecordCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sets_.clear();
+  size_ = 0;
+}
+
+}  // namespace mdns_cpp
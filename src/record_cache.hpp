@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "dns_name.hpp"
+#include "mdns_cpp/defs.hpp"
+
+namespace mdns_cpp {
+
+// Tells records of the same name and type apart, comparing target names case-insensitively
+std::uint64_t recordDataHash(const QueryRecord &record);
+
+// The records received by the queries, kept for their TTL (RFC 6762 section 10).
+//
+// Record sets are keyed by folded owner name, type and class, so a lookup is a single hash probe. A record received
+// again refreshes its TTL, a record with TTL 0 (goodbye) and the records flushed by a newer record with the cache-flush
+// bit are dropped one second later. A record is answered from the cache until 80% of its TTL passed, the point where
+// RFC 6762 section 5.2 has queriers ask the network again.
+//
+// Once capacity records are cached, expired records are purged. If that frees nothing, the records closest to expiry
+// are evicted, a sixteenth of the capacity at once, so the scan this takes is shared by the inserts that follow. All
+// functions may be called from any thread.
+class RecordCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t default_capacity = 4096;
+
+  explicit RecordCache(size_t capacity = default_capacity);
+
+  RecordCache(const RecordCache &) = delete;
+  RecordCache &operator=(const RecordCache &) = delete;
+
+  // Stores a record received at now. rclass is the class as received, including the cache-flush bit.
+  void insert(const QueryRecord &record, std::uint16_t rclass, Clock::time_point now);
+
+  // Appends the fresh records of type rtype named name to records, with their TTL set to the seconds left, followed by
+  // the fresh records a responder would add to them (RFC 6763 section 12): SRV and TXT records of PTR targets and
+  // address records of SRV targets. Returns the number of answers; nothing is appended if there is none. Queries for
+  // ANY are never answered, the cache cannot tell whether it holds all types.
+  size_t answer(const FoldedName &name, std::uint16_t rtype, Clock::time_point now, std::vector<QueryRecord> &records);
+
+  // Appends the records of type rtype (any type for ANY) named name with more than half of their TTL left to records,
+  // with their TTL set to the seconds left. These are the known answers of a query (RFC 6762 section 7.1).
+  size_t knownAnswers(const FoldedName &name, std::uint16_t rtype, Clock::time_point now,
+                      std::vector<QueryRecord> &records);
+
+  // Records cached at most, 0 disables the cache. Shrinking the capacity evicts the records closest to expiry.
+  void setCapacity(size_t capacity);
+  size_t size() const;
+  void clear();
+
+ private:
+  struct Entry {
+    QueryRecord record;
+    std::uint64_t data_hash{0};
+    Clock::time_point received{};
+    Clock::time_point fresh_until{};
+    Clock::time_point expires{};
+  };
+  struct RecordSet {
+    FoldedName name;
+    std::uint16_t rtype{0};
+    std::uint16_t rclass{0};
+    std::vector<Entry> entries;
+  };
+
+  RecordSet *find(const FoldedName &name, std::uint16_t rtype, std::uint16_t rclass);
+  // Appends the fresh records of a set, or only those with more than half of their TTL left, returns their number
+  size_t collect(const FoldedName &name, std::uint16_t rtype, RecordSection section, Clock::time_point now,
+                 std::vector<QueryRecord> &records, bool half_ttl_left = false);
+  void purge(Clock::time_point now);
+  // Drops the count records that expire first
+  void evict(size_t count);
+  // Drops the entries matching pred, and the sets left empty
+  template <typename Pred>
+  void eraseIf(Pred pred);
+
+  mutable std::mutex mutex_;
+  size_t capacity_;
+  size_t size_{0};
+  Clock::time_point last_purge_{};
+  std::unordered_multimap<std::uint64_t, RecordSet> sets_;
+  FoldedName target_;
+  std::vector<Clock::time_point> expiries_;
+};
+
+}  // namespace mdns_cpp
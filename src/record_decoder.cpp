@@ -0,0 +1,91 @@
+#include "record_decoder.hpp"
+
+#include <string.h>
+
+#include "dns_name.hpp"
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+namespace {
+
+// Splits TXT record data into its strings and each string at the first "=" (RFC 6763 section 6.3)
+void decodeTxt(QueryRecord &record) {
+  record.txt_entries.clear();
+  const auto *data = reinterpret_cast<const std::uint8_t *>(record.txt.data());
+  const size_t size = record.txt.size();
+  size_t offset = 0;
+  while (offset < size) {
+    const size_t length = data[offset++];
+    if (length > size - offset) {
+      break;
+    }
+    // Empty strings and strings starting with "=" carry no key and are ignored
+    if (length && data[offset] != '=') {
+      TxtEntry entry;
+      entry.key_offset = static_cast<std::uint16_t>(offset);
+      const void *separator = memchr(data + offset, '=', length);
+      if (separator) {
+        const size_t key_length = static_cast<const std::uint8_t *>(separator) - (data + offset);
+        entry.key_length = static_cast<std::uint16_t>(key_length);
+        entry.value_offset = static_cast<std::uint16_t>(offset + key_length + 1);
+        entry.value_length = static_cast<std::uint16_t>(length - key_length - 1);
+        entry.has_value = true;
+      } else {
+        entry.key_length = static_cast<std::uint16_t>(length);
+      }
+      record.txt_entries.push_back(entry);
+    }
+    offset += length;
+  }
+}
+
+}  // namespace
+
+bool decodeRecord(const RecordView &view, QueryRecord &record) {
+  if (!view.name().decode(record.name)) {
+    return false;
+  }
+  record.type = view.type();
+  record.ttl = view.ttl();
+  record.section = view.section();
+  record.target.clear();
+  record.priority = 0;
+  record.weight = 0;
+  record.port = 0;
+  record.address_ipv4 = 0;
+  memset(record.address_ipv6, 0, sizeof(record.address_ipv6));
+  record.txt.clear();
+  record.txt_entries.clear();
+
+  switch (view.type()) {
+    case MDNS_RECORDTYPE_PTR:
+      view.target().decode(record.target);
+      break;
+    case MDNS_RECORDTYPE_SRV: {
+      SrvView srv;
+      if (view.srv(srv)) {
+        srv.target.decode(record.target);
+        record.priority = srv.priority;
+        record.weight = srv.weight;
+        record.port = srv.port;
+      }
+      break;
+    }
+    case MDNS_RECORDTYPE_A:
+      view.ipv4(record.address_ipv4);
+      break;
+    case MDNS_RECORDTYPE_AAAA:
+      view.ipv6(record.address_ipv6);
+      break;
+    case MDNS_RECORDTYPE_TXT:
+      record.txt.assign(view.txt());
+      decodeTxt(record);
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+}  // namespace mdns_cpp
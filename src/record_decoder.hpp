@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mdns_cpp/defs.hpp"
+#include "packet_view.hpp"
+
+namespace mdns_cpp {
+
+// Decodes a record of a received packet into record. The strings and vectors of record keep their capacity, so
+// decoding into the same object again does not allocate once they have grown. Returns false if the owner name is
+// malformed.
+bool decodeRecord(const RecordView &view, QueryRecord &record);
+
+}  // namespace mdns_cpp
@@ -0,0 +1,141 @@
+#include "resolution.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mdns.h"
+
+namespace mdns_cpp {
+
+Resolution::Resolution(const FoldedName &service) : service_(service) {}
+
+Resolution::Instance *Resolution::findInstance(const FoldedName &name) {
+  const auto it = std::find_if(instances_.begin(), instances_.end(),
+                               [&](const Instance &instance) { return instance.name == name; });
+  return (it != instances_.end()) ? &*it : nullptr;
+}
+
+Resolution::Host *Resolution::findHost(const FoldedName &name) {
+  const auto it = std::find_if(hosts_.begin(), hosts_.end(), [&](const Host &host) { return host.name == name; });
+  return (it != hosts_.end()) ? &*it : nullptr;
+}
+
+void Resolution::add(const QueryRecord &record) {
+  // Goodbyes withdraw what a resolve is about to report, they are not worth following
+  if (!record.ttl || !foldName(record.name, name_)) {
+    return;
+  }
+  switch (record.type) {
+    case MDNS_RECORDTYPE_PTR:
+      if (name_ == service_ && foldName(record.target, target_) && !findInstance(target_)) {
+        instances_.emplace_back();
+        instances_.back().name = target_;
+        instances_.back().service.instance = record.target;
+      }
+      break;
+    case MDNS_RECORDTYPE_SRV:
+      if (Instance *instance = findInstance(name_)) {
+        if (foldName(record.target, instance->host)) {
+          instance->has_srv = true;
+          instance->service.host = record.target;
+          instance->service.port = record.port;
+          instance->service.priority = record.priority;
+          instance->service.weight = record.weight;
+          instance->service.interface_index = record.interface_index;
+        }
+      }
+      break;
+    case MDNS_RECORDTYPE_TXT:
+      if (Instance *instance = findInstance(name_)) {
+        instance->has_txt = true;
+        instance->service.txt = record.txt;
+        instance->service.txt_entries = record.txt_entries;
+      }
+      break;
+    case MDNS_RECORDTYPE_A:
+    case MDNS_RECORDTYPE_AAAA: {
+      Host *host = findHost(name_);
+      if (!host) {
+        hosts_.emplace_back();
+        host = &hosts_.back();
+        host->name = name_;
+      }
+      if (record.type == MDNS_RECORDTYPE_A) {
+        if (std::find(host->ipv4.begin(), host->ipv4.end(), record.address_ipv4) == host->ipv4.end()) {
+          host->ipv4.push_back(record.address_ipv4);
+        }
+      } else {
+        std::array<std::uint8_t, 16> address;
+        std::memcpy(address.data(), record.address_ipv6, address.size());
+        if (std::find(host->ipv6.begin(), host->ipv6.end(), address) == host->ipv6.end()) {
+          host->ipv6.push_back(address);
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+bool Resolution::wants(const FoldedName &name, std::uint16_t rtype) const {
+  if (rtype == MDNS_RECORDTYPE_PTR && name == service_) {
+    return true;
+  }
+  return std::any_of(asked_.begin(), asked_.end(),
+                     [&](const Question &question) { return question.rtype == rtype && question.folded == name; });
+}
+
+void Resolution::takeResolved(std::vector<ResolvedService> &resolved, bool final) {
+  for (Instance &instance : instances_) {
+    if (instance.reported || !instance.has_srv || (!instance.has_txt && !final)) {
+      continue;
+    }
+    const Host *host = findHost(instance.host);
+    if (!host || (host->ipv4.empty() && host->ipv6.empty())) {
+      continue;
+    }
+    instance.reported = true;
+    instance.service.addresses_ipv4 = host->ipv4;
+    instance.service.addresses_ipv6 = host->ipv6;
+    resolved.push_back(instance.service);
+  }
+}
+
+void Resolution::ask(const std::string &name, std::uint16_t rtype, std::vector<Question> &questions) {
+  Question question;
+  if (!foldName(name, question.folded) || wants(question.folded, rtype)) {
+    return;
+  }
+  question.name = name;
+  question.rtype = rtype;
+  asked_.push_back(question);
+  questions.push_back(std::move(question));
+}
+
+size_t Resolution::followUps(std::vector<Question> &questions) {
+  const size_t first = questions.size();
+  for (const Instance &instance : instances_) {
+    if (instance.reported) {
+      continue;
+    }
+    if (!instance.has_srv) {
+      ask(instance.service.instance, MDNS_RECORDTYPE_SRV, questions);
+    }
+    if (!instance.has_txt) {
+      ask(instance.service.instance, MDNS_RECORDTYPE_TXT, questions);
+    }
+    const Host *host = instance.has_srv ? findHost(instance.host) : nullptr;
+    if (instance.has_srv && (!host || (host->ipv4.empty() && host->ipv6.empty()))) {
+      ask(instance.service.host, MDNS_RECORDTYPE_A, questions);
+      ask(instance.service.host, MDNS_RECORDTYPE_AAAA, questions);
+    }
+  }
+  return questions.size() - first;
+}
+
+bool Resolution::complete() const {
+  return std::all_of(instances_.begin(), instances_.end(), [](const Instance &instance) { return instance.reported; });
+}
+
+}  // namespace mdns_cpp
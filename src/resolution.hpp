@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dns_name.hpp"
+#include "mdns_cpp/defs.hpp"
+
+namespace mdns_cpp {
+
+// What a resolve learned about the instances of a service type and the hosts they run on.
+//
+// Responders send the SRV and TXT records of the instances and the addresses of their hosts as additional records of
+// a PTR response (RFC 6763 section 12), so every record of every response is harvested, whatever question it came
+// with. Only the pieces still missing once the responses stopped are asked for: SRV and TXT records of instances, then
+// the addresses of hosts. Each question is asked at most once, so a resolve takes at most three rounds and usually one.
+//
+// Not synchronized, a resolution lives on the query thread.
+class Resolution {
+ public:
+  struct Question {
+    std::string name;
+    FoldedName folded;
+    std::uint16_t rtype{0};
+  };
+
+  explicit Resolution(const FoldedName &service);
+
+  // Takes in a received record of any name and type
+  void add(const QueryRecord &record);
+
+  // True for the records the resolution asked for: PTR records of the service type and the answers to its follow-up
+  // questions
+  bool wants(const FoldedName &name, std::uint16_t rtype) const;
+
+  // Appends the instances with an SRV record, a TXT record and an address that were not reported yet. Once final,
+  // instances without TXT record are reported as well; the others never resolved.
+  void takeResolved(std::vector<ResolvedService> &resolved, bool final = false);
+
+  // Appends the questions for the pieces missing from the instances not reported yet that were not asked before,
+  // returns their number
+  size_t followUps(std::vector<Question> &questions);
+
+  // True once follow-up questions were asked
+  bool followingUp() const { return !asked_.empty(); }
+  // True if every instance found so far was reported
+  bool complete() const;
+
+ private:
+  struct Host {
+    FoldedName name;
+    std::vector<std::uint32_t> ipv4;
+    std::vector<std::array<std::uint8_t, 16>> ipv6;
+  };
+  struct Instance {
+    FoldedName name;
+    ResolvedService service;
+    FoldedName host;
+    bool has_srv{false};
+    bool has_txt{false};
+    bool reported{false};
+  };
+
+  Instance *findInstance(const FoldedName &name);
+  Host *findHost(const FoldedName &name);
+  // Appends a question unless it was asked before
+  void ask(const std::string &name, std::uint16_t rtype, std::vector<Question> &questions);
+
+  FoldedName service_;
+  std::vector<Instance> instances_;
+  std::vector<Host> hosts_;
+  std::vector<Question> asked_;
+  FoldedName name_;
+  FoldedName target_;
+};
+
+}  // namespace mdns_cpp
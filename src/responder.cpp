@@ -0,0 +1,237 @@
+#include "responder.hpp"
+
+#include "mdns_cpp/macros.hpp"
+#include "mdns_cpp/utils.hpp"
+
+namespace mdns_cpp {
+
+namespace {
+
+constexpr std::uint32_t unicast_ttl = ServiceRegistry::unicast_ttl;
+constexpr std::uint32_t dns_sd_ttl = ServiceRegistry::unicast_ttl;
+
+const FoldedName &dnsSdName() {
+  static const FoldedName name = []() {
+    FoldedName folded;
+    foldName("_services._dns-sd._udp.local.", folded);
+    return folded;
+  }();
+  return name;
+}
+
+// Calls fn(rtype) for every type of record of an instance answering a question for name and qtype
+template <typename Fn>
+void forEachAnswerType(const FoldedName &name, std::uint16_t qtype, const ServiceRegistry::Entry &entry, Fn &&fn) {
+  const auto answer = [&](std::uint16_t rtype) {
+    if (qtype == rtype || qtype == MDNS_RECORDTYPE_ANY) {
+      fn(rtype);
+    }
+  };
+  if (name == entry.type_name) {
+    answer(MDNS_RECORDTYPE_PTR);
+  }
+  if (name == entry.instance_name) {
+    answer(MDNS_RECORDTYPE_SRV);
+    answer(MDNS_RECORDTYPE_TXT);
+  }
+  if (name == entry.host_name) {
+    answer(MDNS_RECORDTYPE_A);
+    answer(MDNS_RECORDTYPE_AAAA);
+  }
+}
+
+}  // namespace
+
+Responder::Responder(ResponseScheduler &scheduler) : scheduler_(scheduler) {}
+
+void Responder::handlePacket(const ServiceRegistry &registry, int sock, const sockaddr *from, size_t addrlen,
+                             const void *data, size_t size) {
+  registry_ = &registry;
+  sock_ = sock;
+  from_ = from;
+  addrlen_ = addrlen;
+  questions_.clear();
+  known_answers_.clear();
+
+  // Responses from other hosts are not queries, malformed packets are not answered at all
+  if (PacketView(data, size).isResponse() || !index_.build(data, size)) {
+    return;
+  }
+  if (readQuestions()) {
+    // Known answers held by the querier (RFC 6762 section 7.1)
+    for (size_t irecord = 0; irecord < index_.sectionEnd(RecordSection::Answer); ++irecord) {
+      addKnownAnswer(index_.record(irecord));
+    }
+  }
+
+  for (const auto &question : questions_) {
+    answerQuestion(question);
+  }
+}
+
+bool Responder::readQuestions() {
+  const PacketView &packet = index_.packet();
+  query_id_ = packet.id();
+  for (size_t iquestion = 0; iquestion < index_.questionCount(); ++iquestion) {
+    const QuestionView received = index_.question(iquestion);
+    // Only questions of class IN are answered, a DNS-SD meta query must come alone and without flags
+    if ((received.rclass & 0x7FFF) != MDNS_CLASS_IN) {
+      questions_.clear();
+      return false;
+    }
+    questions_.emplace_back();
+    Question &question = questions_.back();
+    if (!received.name.fold(question.name)) {
+      questions_.clear();
+      return false;
+    }
+    if (question.name == dnsSdName() && (packet.flags() || packet.questionCount() != 1)) {
+      questions_.clear();
+      return false;
+    }
+    question.rtype = received.rtype;
+    question.rclass = received.rclass;
+  }
+  return true;
+}
+
+void Responder::addKnownAnswer(const RecordView &record) {
+  FoldedName name;
+  if (!record.name().fold(name)) {
+    return;
+  }
+
+  std::uint64_t rdata_hash = 0;
+  FoldedName target;
+  const std::uint8_t *rdata = record.data();
+  if (record.type() == MDNS_RECORDTYPE_PTR) {
+    if (!record.target().fold(target)) {
+      return;
+    }
+    rdata_hash = target.hash;
+  } else if (record.type() == MDNS_RECORDTYPE_SRV) {
+    SrvView srv;
+    if (record.dataLength() < 8 || !record.srv(srv) || !srv.target.fold(target)) {
+      return;
+    }
+    const std::uint64_t priority_weight_port =
+        (static_cast<std::uint64_t>(rdata[0]) << 40) | (static_cast<std::uint64_t>(rdata[1]) << 32) |
+        (static_cast<std::uint64_t>(rdata[2]) << 24) | (static_cast<std::uint64_t>(rdata[3]) << 16) |
+        (static_cast<std::uint64_t>(rdata[4]) << 8) | static_cast<std::uint64_t>(rdata[5]);
+    rdata_hash = mixHash(target.hash, priority_weight_port);
+  } else {
+    rdata_hash = hashBytes(rdata, record.dataLength());
+  }
+
+  auto &known_ttl = known_answers_[recordDigest(name.hash, record.type(), rdata_hash)];
+  if (record.ttl() > known_ttl) {
+    known_ttl = record.ttl();
+  }
+}
+
+bool Responder::isKnownAnswer(std::uint64_t digest, std::uint32_t ttl) const {
+  if (!digest || known_answers_.empty()) {
+    return false;
+  }
+  const auto it = known_answers_.find(digest);
+  return (it != known_answers_.end()) && (it->second > ttl / 2);
+}
+
+void Responder::answerQuestion(const Question &question) {
+  char addrbuffer[64] = {0};
+
+  if (question.rtype == MDNS_RECORDTYPE_PTR && question.name == dnsSdName()) {
+    const auto fromaddrstr = ipAddressToString(addrbuffer, sizeof(addrbuffer), from_, addrlen_);
+    MDNS_LOG << fromaddrstr << " : question PTR _services._dns-sd._udp.local.\n";
+    registry_->forEachType([&](const ServiceRegistry::ServiceType &type) {
+      if (isKnownAnswer(recordDigest(dnsSdName().hash, MDNS_RECORDTYPE_PTR, type.folded.hash), dns_sd_ttl)) {
+        MDNS_LOG << "  --> known answer " << type.name << " \n";
+        return;
+      }
+      if (const auto *packet = registry_->dnsSdAnswer(type)) {
+        MDNS_LOG << "  --> answer " << type.name << " \n";
+        mdns_unicast_send(sock_, from_, addrlen_, packet->data(), packet->size());
+      }
+    });
+    return;
+  }
+
+  const bool unicast = (question.rclass & MDNS_UNICAST_RESPONSE);
+  registry_->forEachMatch(question.name, question.rtype, [&](const ServiceRegistry::Entry &entry) {
+    const ServiceInstance &instance = entry.instance;
+    const auto fromaddrstr = ipAddressToString(addrbuffer, sizeof(addrbuffer), from_, addrlen_);
+    if (!unicast) {
+      if (scheduleAnswer(question, entry)) {
+        MDNS_LOG << fromaddrstr << " : question type " << question.rtype << " --> answer " << instance.hostname << "."
+                 << instance.name << " port " << instance.port << " (multicast, scheduled)\n";
+      } else {
+        MDNS_LOG << fromaddrstr << " : question type " << question.rtype << " --> known answer " << instance.hostname
+                 << "." << instance.name << "\n";
+      }
+      return;
+    }
+
+    // A question for a single record gets the answer cached by the registry unless the querier already knows the
+    // record, ANY questions and answers that did not fit a packet are written as asked
+    bool answered = false;
+    const auto *packet = registry_->answer(entry, question.rtype);
+    if (!packet) {
+      answered = sendAnswer(question, entry);
+    } else if (!isKnownAnswer(registry_->recordDigest(entry, question.rtype), unicast_ttl)) {
+      reply_.assign(packet->begin(), packet->end());
+      ResponseCache::setQueryId(reply_, query_id_);
+      mdns_unicast_send(sock_, from_, addrlen_, reply_.data(), reply_.size());
+      answered = true;
+    }
+    if (!answered) {
+      MDNS_LOG << fromaddrstr << " : question type " << question.rtype << " --> known answer " << instance.hostname
+               << "." << instance.name << "\n";
+      return;
+    }
+    MDNS_LOG << fromaddrstr << " : question type " << question.rtype << " --> answer " << instance.hostname << "."
+             << instance.name << " port " << instance.port << " (unicast)\n";
+  });
+}
+
+bool Responder::sendAnswer(const Question &question, const ServiceRegistry::Entry &entry) {
+  unicast_answer_.begin(query_id_, 0x8400);
+  PacketWriter &writer = unicast_answer_.writer();
+  const std::string &name = (question.name == entry.type_name)       ? entry.type_wire
+                            : (question.name == entry.instance_name) ? entry.instance_wire
+                                                                     : entry.host_wire;
+  if (!writer.addQuestion(name, question.rtype, question.rclass)) {
+    return false;
+  }
+  size_t answers = 0;
+  forEachAnswerType(question.name, question.rtype, entry, [&](std::uint16_t rtype) {
+    const std::uint64_t digest = registry_->recordDigest(entry, rtype);
+    if (digest && !isKnownAnswer(digest, unicast_ttl) &&
+        unicast_answer_.add([&](PacketWriter &packet) {
+          return registry_->writeRecord(packet, PacketWriter::Section::Answer, entry, rtype, unicast_ttl);
+        })) {
+      ++answers;
+    }
+  });
+  if (!answers) {
+    return false;
+  }
+  for (size_t ipacket = 0; ipacket < unicast_answer_.packets(); ++ipacket) {
+    mdns_unicast_send(sock_, from_, addrlen_, unicast_answer_.data(ipacket), unicast_answer_.size(ipacket));
+  }
+  return true;
+}
+
+size_t Responder::scheduleAnswer(const Question &question, const ServiceRegistry::Entry &entry) {
+  const auto now = ResponseScheduler::Clock::now();
+  size_t scheduled = 0;
+  forEachAnswerType(question.name, question.rtype, entry, [&](std::uint16_t rtype) {
+    const std::uint64_t digest = registry_->recordDigest(entry, rtype);
+    if (digest && !isKnownAnswer(digest, ServiceRegistry::multicast_ttl)) {
+      scheduler_.schedule(sock_, entry.id, rtype, now);
+      ++scheduled;
+    }
+  });
+  return scheduled;
+}
+
+}  // namespace mdns_cpp
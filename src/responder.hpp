@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "dns_name.hpp"
+#include "mdns.h"
+#include "message_builder.hpp"
+#include "packet_index.hpp"
+#include "response_scheduler.hpp"
+#include "service_registry.hpp"
+
+namespace mdns_cpp {
+
+// Answers the queries received by the service sockets from the service registry.
+//
+// A query is handled as a whole: its questions and its known-answer list are collected first, then every answer the
+// querier already holds with more than half of our TTL left is suppressed (RFC 6762 section 7.1). Unicast answers are
+// sent right away, multicast answers are handed to the scheduler record by record.
+class Responder {
+ public:
+  explicit Responder(ResponseScheduler &scheduler);
+
+  // Parses one received packet and answers it from registry
+  void handlePacket(const ServiceRegistry &registry, int sock, const sockaddr *from, size_t addrlen, const void *data,
+                    size_t size);
+
+ private:
+  struct Question {
+    FoldedName name;
+    std::uint16_t rtype;
+    std::uint16_t rclass;
+  };
+
+  // Collects the questions of a query, returns false if the packet is not to be answered
+  bool readQuestions();
+  void addKnownAnswer(const RecordView &record);
+  // True if the querier listed the record with more than half of the given TTL remaining
+  bool isKnownAnswer(std::uint64_t digest, std::uint32_t ttl) const;
+
+  void answerQuestion(const Question &question);
+  // Sends the records of an instance answering a unicast question, false if it has none the querier does not know
+  bool sendAnswer(const Question &question, const ServiceRegistry::Entry &entry);
+  // Queues the records of an instance answering a multicast question, returns how many were queued
+  size_t scheduleAnswer(const Question &question, const ServiceRegistry::Entry &entry);
+
+  ResponseScheduler &scheduler_;
+  // Cached unicast answer copied from the registry to patch in the query ID
+  std::vector<std::uint8_t> reply_;
+  // Unicast answers that are not cached or hold known answers, built as asked
+  MessageBuilder unicast_answer_;
+
+  // State of the packet being handled
+  const ServiceRegistry *registry_{nullptr};
+  int sock_{-1};
+  const sockaddr *from_{nullptr};
+  size_t addrlen_{0};
+  std::uint16_t query_id_{0};
+  PacketIndex index_;
+  std::vector<Question> questions_;
+  // Digest of (name, type, rdata) of each known answer mapped to its TTL
+  std::unordered_map<std::uint64_t, std::uint32_t> known_answers_;
+};
+
+}  // namespace mdns_cpp
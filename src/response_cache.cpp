@@ -0,0 +1,24 @@
+#include "response_cache.hpp"
+
+namespace mdns_cpp {
+
+const std::vector<std::uint8_t> *ResponseCache::find(std::uint16_t qtype) const {
+  const auto it = responses_.find(qtype);
+  return (it != responses_.end()) ? &it->second : nullptr;
+}
+
+void ResponseCache::store(std::uint16_t qtype, const void *packet, size_t size) {
+  const auto *bytes = static_cast<const std::uint8_t *>(packet);
+  responses_[qtype].assign(bytes, bytes + size);
+}
+
+void ResponseCache::clear() { responses_.clear(); }
+
+void ResponseCache::setQueryId(std::vector<std::uint8_t> &packet, std::uint16_t query_id) {
+  if (packet.size() >= 2) {
+    packet[0] = static_cast<std::uint8_t>(query_id >> 8);
+    packet[1] = static_cast<std::uint8_t>(query_id & 0xFF);
+  }
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace mdns_cpp {
+
+// Ready-made unicast answers of an advertised service instance.
+//
+// An answer only depends on the instance data, so it is serialized once per question type and replayed for every
+// matching question with just the query ID patched in. Multicast answers are not cached: ResponseScheduler aggregates
+// the records of every question it is answering into shared packets. The cache must be rebuilt whenever the instance
+// data changes.
+class ResponseCache {
+ public:
+  // Returns the cached answer to a question of type qtype, or nullptr if it has not been built
+  const std::vector<std::uint8_t> *find(std::uint16_t qtype) const;
+  void store(std::uint16_t qtype, const void *packet, size_t size);
+  void clear();
+
+  // Writes query_id into the header of a cached answer
+  static void setQueryId(std::vector<std::uint8_t> &packet, std::uint16_t query_id);
+
+ private:
+  std::unordered_map<std::uint16_t, std::vector<std::uint8_t>> responses_;
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,282 @@
+#include "response_scheduler.hpp"
+
+#include <algorithm>
+
+namespace mdns_cpp {
+
+namespace {
+
+// Random delay of answers with shared records (RFC 6762 section 6)
+constexpr int min_shared_delay_ms = 20;
+constexpr int max_shared_delay_ms = 120;
+// Minimum interval between two multicasts of the same record on the same interface
+constexpr auto multicast_interval = std::chrono::seconds(1);
+
+inline std::uint64_t pendingKey(ServiceId id, std::uint16_t rtype) { return mixHash(id, rtype); }
+
+}  // namespace
+
+bool MulticastHistory::claim(std::uint64_t link, std::uint64_t digest, Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (now - last_expiry_ >= multicast_interval) {
+    for (auto it = last_multicast_.begin(); it != last_multicast_.end();) {
+      if (now - it->second >= multicast_interval) {
+        it = last_multicast_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    last_expiry_ = now;
+  }
+
+  const auto inserted = last_multicast_.emplace(mixHash(digest, link), now);
+  if (!inserted.second) {
+    if (now - inserted.first->second < multicast_interval) {
+      return false;
+    }
+    inserted.first->second = now;
+  }
+  return true;
+}
+
+void MulticastHistory::release(std::uint64_t link, std::uint64_t digest) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  last_multicast_.erase(mixHash(digest, link));
+}
+
+ResponseScheduler::ResponseScheduler(MulticastHistory &history, size_t max_packet_size)
+    : history_(history), random_(std::random_device{}()), message_(max_packet_size) {}
+
+void ResponseScheduler::schedule(int sock, ServiceId id, std::uint16_t rtype, Clock::time_point now) {
+  Clock::time_point deadline = now;
+  if (rtype == MDNS_RECORDTYPE_PTR) {
+    Queue &queue = queues_[sock];
+    if (queue.shared_deadline <= now) {
+      std::uniform_int_distribution<int> delay(min_shared_delay_ms, max_shared_delay_ms);
+      queue.shared_deadline = now + std::chrono::milliseconds(delay(random_));
+    }
+    deadline = queue.shared_deadline;
+  }
+  enqueue(sock, id, rtype, deadline);
+}
+
+void ResponseScheduler::enqueue(int sock, ServiceId id, std::uint16_t rtype, Clock::time_point deadline) {
+  Queue &queue = queues_[sock];
+  const auto inserted = queue.positions.emplace(pendingKey(id, rtype), queue.records.size());
+  if (inserted.second) {
+    queue.records.push_back(Pending{id, rtype, deadline});
+  } else {
+    Pending &pending = queue.records[inserted.first->second];
+    pending.deadline = std::min(pending.deadline, deadline);
+  }
+  if (deadline < queue.deadline) {
+    queue.deadline = deadline;
+    arm(sock, queue);
+  }
+}
+
+void ResponseScheduler::arm(int sock, Queue &queue) {
+  if (queue.timer) {
+    wheel_.cancel(queue.timer);
+  }
+  queue.timer = wheel_.schedule(queue.deadline, [this, sock]() { flushQueue(sock); });
+}
+
+void ResponseScheduler::announce(Clock::time_point now) {
+  announcements_left_ = announcements;
+  wheel_.schedule(now, [this]() { announceAll(); });
+}
+
+void ResponseScheduler::announce(ServiceId id, Clock::time_point now) {
+  for (int iannouncement = 0; iannouncement < announcements; ++iannouncement) {
+    wheel_.schedule(now + std::chrono::seconds(iannouncement), [this, id]() { announceInstance(id); });
+  }
+}
+
+void ResponseScheduler::announceAll() {
+  registry_->forEachEntry([&](const ServiceRegistry::Entry &entry) { announceInstance(entry.id); });
+  if (--announcements_left_ > 0) {
+    wheel_.schedule(now_ + std::chrono::seconds(1), [this]() { announceAll(); });
+  }
+}
+
+void ResponseScheduler::announceInstance(ServiceId id) {
+  static const std::uint16_t record_types[] = {MDNS_RECORDTYPE_PTR, MDNS_RECORDTYPE_SRV, MDNS_RECORDTYPE_TXT,
+                                               MDNS_RECORDTYPE_A, MDNS_RECORDTYPE_AAAA};
+  // An instance removed meanwhile is not announced
+  if (!registry_->find(id)) {
+    return;
+  }
+  for (const auto &socket : sockets_) {
+    for (const std::uint16_t rtype : record_types) {
+      enqueue(socket.first, id, rtype, now_);
+    }
+  }
+}
+
+void ResponseScheduler::goodbye(const ServiceRegistry &registry, const ServiceRegistry::Entry &entry) {
+  static const std::uint16_t record_types[] = {MDNS_RECORDTYPE_PTR, MDNS_RECORDTYPE_SRV, MDNS_RECORDTYPE_TXT,
+                                               MDNS_RECORDTYPE_A, MDNS_RECORDTYPE_AAAA};
+  for (const auto &socket : sockets_) {
+    message_.begin(0, 0x8400);
+    for (const std::uint16_t rtype : record_types) {
+      const std::uint64_t digest = registry.recordDigest(entry, rtype);
+      if (digest && !registry.holdsRecord(entry, rtype, digest)) {
+        message_.add([&](PacketWriter &writer) {
+          return registry.writeRecord(writer, PacketWriter::Section::Answer, entry, rtype, 0);
+        });
+      }
+    }
+    for (size_t ipacket = 0; ipacket < message_.packets(); ++ipacket) {
+      mdns_multicast_send_info(socket.second, message_.data(ipacket), message_.size(ipacket));
+    }
+  }
+}
+
+void ResponseScheduler::flush(const ServiceRegistry &registry, Clock::time_point now) {
+  registry_ = &registry;
+  now_ = now;
+  wheel_.advance(now);
+  registry_ = nullptr;
+}
+
+void ResponseScheduler::flushQueue(int sock) {
+  const auto it = queues_.find(sock);
+  if (it == queues_.end()) {
+    return;
+  }
+  Queue &queue = it->second;
+  queue.timer = 0;
+
+  answers_.clear();
+  size_t kept = 0;
+  Clock::time_point deadline = Clock::time_point::max();
+  for (const Pending &pending : queue.records) {
+    if (pending.deadline > now_) {
+      deadline = std::min(deadline, pending.deadline);
+      queue.records[kept++] = pending;
+      continue;
+    }
+    if (const auto *entry = registry_->find(pending.id)) {
+      answers_.push_back(Answer{entry, pending.rtype, false});
+    }
+  }
+  queue.records.resize(kept);
+  queue.positions.clear();
+  for (size_t i = 0; i < kept; ++i) {
+    queue.positions.emplace(pendingKey(queue.records[i].id, queue.records[i].rtype), i);
+  }
+  queue.deadline = deadline;
+
+  send(*registry_, sock, answers_, now_);
+
+  if (queue.records.empty()) {
+    queues_.erase(it);
+  } else {
+    arm(sock, queue);
+  }
+}
+
+void ResponseScheduler::send(const ServiceRegistry &registry, int sock, std::vector<Answer> &answers,
+                             Clock::time_point now) {
+  const std::uint32_t ttl = ServiceRegistry::multicast_ttl;
+  const auto socket_it = sockets_.find(sock);
+  if (socket_it == sockets_.end()) {
+    return;
+  }
+  const mdns_socket_info_t &socket = *socket_it->second;
+  const std::uint64_t link = mixHash(static_cast<std::uint64_t>(socket.family), socket.interface_index);
+
+  message_.begin(0, 0x8400);
+  PacketWriter &writer = message_.writer();
+  size_t next = 0;
+  while (next < answers.size()) {
+    message_.next();
+    const size_t first = next;
+    for (; next < answers.size(); ++next) {
+      Answer &answer = answers[next];
+      const std::uint64_t digest = registry.recordDigest(*answer.entry, answer.rtype);
+      if (!digest || !history_.claim(link, digest, now)) {
+        continue;
+      }
+      if (!registry.writeRecord(writer, PacketWriter::Section::Answer, *answer.entry, answer.rtype, ttl)) {
+        history_.release(link, digest);
+        break;
+      }
+      answer.sent = true;
+    }
+    if (!writer.records()) {
+      // Nothing left to send, or a single record that does not even fit an empty packet
+      ++next;
+      continue;
+    }
+
+    // Add what the querier would ask for next as far as it fits: SRV, TXT and addresses for an instance found by its
+    // PTR record, addresses for a SRV record
+    for (size_t i = first; i < next; ++i) {
+      const Answer &answer = answers[i];
+      if (!answer.sent) {
+        continue;
+      }
+      static const std::uint16_t instance_records[] = {MDNS_RECORDTYPE_SRV, MDNS_RECORDTYPE_TXT, MDNS_RECORDTYPE_A,
+                                                       MDNS_RECORDTYPE_AAAA};
+      const std::uint16_t *additional = instance_records;
+      size_t count = 0;
+      if (answer.rtype == MDNS_RECORDTYPE_PTR) {
+        count = 4;
+      } else if (answer.rtype == MDNS_RECORDTYPE_SRV) {
+        additional += 2;
+        count = 2;
+      }
+      for (size_t j = 0; j < count; ++j) {
+        const std::uint64_t digest = registry.recordDigest(*answer.entry, additional[j]);
+        if (digest && history_.claim(link, digest, now) &&
+            !registry.writeRecord(writer, PacketWriter::Section::Additional, *answer.entry, additional[j], ttl)) {
+          history_.release(link, digest);
+        }
+      }
+    }
+  }
+
+  for (size_t ipacket = 0; ipacket < message_.packets(); ++ipacket) {
+    mdns_multicast_send_info(&socket, message_.data(ipacket), message_.size(ipacket));
+  }
+}
+
+void ServiceChanges::withdraw(const ServiceRegistry::Entry &entry) { staged_withdrawn_.push_back(entry); }
+
+void ServiceChanges::announce(ServiceId id) { staged_announced_.push_back(id); }
+
+void ServiceChanges::publish() {
+  if (staged_withdrawn_.empty() && staged_announced_.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  withdrawn_.insert(withdrawn_.end(), staged_withdrawn_.begin(), staged_withdrawn_.end());
+  announced_.insert(announced_.end(), staged_announced_.begin(), staged_announced_.end());
+  staged_withdrawn_.clear();
+  staged_announced_.clear();
+  pending_ = true;
+}
+
+void ServiceChanges::apply(ResponseScheduler &scheduler, const ServiceRegistry &registry,
+                           ResponseScheduler::Clock::time_point now) {
+  if (!pending_.exchange(false)) {
+    return;
+  }
+  std::vector<ServiceRegistry::Entry> withdrawn;
+  std::vector<ServiceId> announced;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    withdrawn.swap(withdrawn_);
+    announced.swap(announced_);
+  }
+  for (const auto &entry : withdrawn) {
+    scheduler.goodbye(registry, entry);
+  }
+  for (const ServiceId id : announced) {
+    scheduler.announce(id, now);
+  }
+}
+
+}  // namespace mdns_cpp
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "mdns.h"
+#include "mdns_cpp/defs.hpp"
+#include "message_builder.hpp"
+#include "service_registry.hpp"
+#include "timer_wheel.hpp"
+
+namespace mdns_cpp {
+
+// When each record was last multicast on each link, shared by the schedulers of all service workers.
+class MulticastHistory {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Notes the record as multicast on the link now and returns true, unless it was multicast there less than a second
+  // ago (RFC 6762 section 6)
+  bool claim(std::uint64_t link, std::uint64_t digest, Clock::time_point now);
+  // Undoes a successful claim for a record that was not sent after all
+  void release(std::uint64_t link, std::uint64_t digest);
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<std::uint64_t, Clock::time_point> last_multicast_;
+  Clock::time_point last_expiry_{};
+};
+
+// Defers, merges and rate limits the multicast answers of the responder (RFC 6762 section 6).
+//
+// Answers with a shared record (PTR) are delayed by a random 20-120 ms so that other responders get to answer as well,
+// and every shared record queued on the socket until then goes out with them. Answers with unique records go out with
+// the next flush. All records due on a socket are written into as few packets as possible, followed by the additional
+// records the querier will need next. A record multicast on a socket less than a second ago is not multicast there
+// again, whichever worker sent it.
+//
+// Records are queued by instance id and looked up again when sent, so instances may be updated or removed meanwhile.
+// Every socket with queued records holds one timer on a timer wheel for its earliest deadline, so finding what is due
+// does not depend on the number of sockets and queued records.
+class ResponseScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Answers are split into packets of at most max_packet_size bytes
+  explicit ResponseScheduler(MulticastHistory &history, size_t max_packet_size = MessageBuilder::default_mtu);
+
+  // Registers a socket answers may be scheduled on. Its interface and address family identify the link, so sockets of
+  // different workers on the same link share their rate limit.
+  void addSocket(const mdns_socket_info_t &socket) { sockets_[socket.sock] = &socket; }
+
+  // Queues the record of type rtype of an instance for a multicast answer on sock
+  void schedule(int sock, ServiceId id, std::uint16_t rtype, Clock::time_point now);
+
+  // Announces every instance of the registry on all sockets starting with the next flush, and once more a second
+  // later (RFC 6762 section 8.3)
+  void announce(Clock::time_point now);
+  // Announces an instance added or changed while the service runs the same way
+  void announce(ServiceId id, Clock::time_point now);
+
+  // Multicasts at once, on all sockets, the records of an instance that was removed or replaced with a TTL of 0 (RFC
+  // 6762 section 10.1). Records some instance of registry still owns, such as unchanged ones, are left out.
+  void goodbye(const ServiceRegistry &registry, const ServiceRegistry::Entry &entry);
+
+  // Milliseconds until the next timer is due (0 if overdue), -1 if none is pending
+  int timeout(Clock::time_point now) const { return wheel_.timeout(now); }
+
+  // Runs the timers that are due and sends the queued answers that are due, looking up their records in registry
+  void flush(const ServiceRegistry &registry, Clock::time_point now);
+
+ private:
+  struct Pending {
+    ServiceId id;
+    std::uint16_t rtype;
+    Clock::time_point deadline;
+  };
+
+  struct Queue {
+    std::vector<Pending> records;
+    // (id, rtype) of every queued record mapped to its position in records
+    std::unordered_map<std::uint64_t, size_t> positions;
+    Clock::time_point deadline{Clock::time_point::max()};
+    // Deadline drawn for the shared records, reused by every question arriving before it passes
+    Clock::time_point shared_deadline{};
+    // Fires at deadline
+    TimerWheel::TimerId timer{0};
+  };
+
+  struct Answer {
+    const ServiceRegistry::Entry *entry;
+    std::uint16_t rtype;
+    bool sent;
+  };
+
+  void enqueue(int sock, ServiceId id, std::uint16_t rtype, Clock::time_point deadline);
+  // Re-arms the timer of a queue for its current deadline
+  void arm(int sock, Queue &queue);
+  void flushQueue(int sock);
+  void announceAll();
+  void announceInstance(ServiceId id);
+  void send(const ServiceRegistry &registry, int sock, std::vector<Answer> &answers, Clock::time_point now);
+
+  // Times every instance is announced
+  static constexpr int announcements = 2;
+
+  MulticastHistory &history_;
+  TimerWheel wheel_;
+  int announcements_left_{0};
+  // Registry and time of the flush running the timers
+  const ServiceRegistry *registry_{nullptr};
+  Clock::time_point now_{};
+  std::minstd_rand random_;
+  std::unordered_map<int, Queue> queues_;
+  std::unordered_map<int, const mdns_socket_info_t *> sockets_;
+  std::vector<Answer> answers_;
+  MessageBuilder message_;
+};
+
+// Changes to the registry made while the service runs that the service workers must multicast, handed from the threads
+// changing the registry to the first worker. A change is staged while the new registry is built and only handed over
+// once that registry is published and no worker reads an older one, so the worker sees the registry it was made in.
+class ServiceChanges {
+ public:
+  // Stages goodbyes for the records of an instance about to be removed or replaced. Staging is serialized by the
+  // writers of the registry.
+  void withdraw(const ServiceRegistry::Entry &entry);
+  // Stages the announcements of an instance added or replaced
+  void announce(ServiceId id);
+  // Hands the staged changes over to the worker
+  void publish();
+  // Passes the changes handed over so far to the scheduler of the worker, reading registry. Goodbyes go out at once,
+  // before the announcements.
+  void apply(ResponseScheduler &scheduler, const ServiceRegistry &registry, ResponseScheduler::Clock::time_point now);
+
+ private:
+  std::vector<ServiceRegistry::Entry> staged_withdrawn_;
+  std::vector<ServiceId> staged_announced_;
+  // Set when changes were handed over, so the worker only locks when there are some
+  std::atomic<bool> pending_{false};
+  std::mutex mutex_;
+  std::vector<ServiceRegistry::Entry> withdrawn_;
+  std::vector<ServiceId> announced_;
+};
+
+}  // namespace mdns_cpp
@@ -0,0 +1,241 @@
+#include "service_registry.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "mdns.h"
+#include "message_builder.hpp"
+
+namespace mdns_cpp {
+
+ServiceId ServiceRegistry::add(const ServiceInstance &instance) {
+  auto entry = std::make_shared<Entry>();
+  if (!setNames(*entry, instance)) {
+    return 0;
+  }
+  entry->id = next_id_++;
+  entry->instance = instance;
+  buildAnswer(*entry);
+
+  const Entry *raw = entry.get();
+  entries_.emplace(raw->id, std::move(entry));
+  link(raw);
+  return raw->id;
+}
+
+bool ServiceRegistry::update(ServiceId id, const ServiceInstance &instance) {
+  const auto it = entries_.find(id);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  auto entry = std::make_shared<Entry>();
+  if (!setNames(*entry, instance)) {
+    return false;
+  }
+  entry->id = id;
+  entry->instance = instance;
+  buildAnswer(*entry);
+
+  unlink(it->second.get());
+  it->second = std::move(entry);
+  link(it->second.get());
+  return true;
+}
+
+bool ServiceRegistry::remove(ServiceId id) {
+  const auto it = entries_.find(id);
+  if (it == entries_.end()) {
+    return false;
+  }
+  unlink(it->second.get());
+  entries_.erase(it);
+  return true;
+}
+
+const ServiceRegistry::Entry *ServiceRegistry::find(ServiceId id) const {
+  const auto it = entries_.find(id);
+  return (it != entries_.end()) ? it->second.get() : nullptr;
+}
+
+void ServiceRegistry::setAddresses(std::uint32_t ipv4, const std::uint8_t *ipv6) {
+  address_ipv4_ = ipv4;
+  has_ipv6_ = (ipv6 != nullptr);
+  if (ipv6) {
+    memcpy(address_ipv6_, ipv6, sizeof(address_ipv6_));
+  }
+  for (auto &item : entries_) {
+    auto entry = std::make_shared<Entry>(*item.second);
+    buildAnswer(*entry);
+    unlink(item.second.get());
+    item.second = std::move(entry);
+    link(item.second.get());
+  }
+}
+
+std::uint64_t ServiceRegistry::recordDigest(const Entry &entry, std::uint16_t rtype) const {
+  const ServiceInstance &instance = entry.instance;
+  switch (rtype) {
+    case MDNS_RECORDTYPE_PTR:
+      return mdns_cpp::recordDigest(entry.type_name.hash, rtype, entry.instance_name.hash);
+    case MDNS_RECORDTYPE_SRV:
+      return mdns_cpp::recordDigest(entry.instance_name.hash, rtype, mixHash(entry.host_name.hash, instance.port));
+    case MDNS_RECORDTYPE_TXT: {
+      if (instance.txt_record.empty() || instance.txt_record.size() > 255) {
+        return 0;
+      }
+      std::uint8_t txt[256];
+      txt[0] = static_cast<std::uint8_t>(instance.txt_record.size());
+      memcpy(txt + 1, instance.txt_record.data(), instance.txt_record.size());
+      return mdns_cpp::recordDigest(entry.instance_name.hash, rtype, hashBytes(txt, instance.txt_record.size() + 1));
+    }
+    case MDNS_RECORDTYPE_A:
+      return address_ipv4_ ? mdns_cpp::recordDigest(entry.host_name.hash, rtype,
+                                                    hashBytes(&address_ipv4_, sizeof(address_ipv4_)))
+                           : 0;
+    case MDNS_RECORDTYPE_AAAA:
+      return has_ipv6_ ? mdns_cpp::recordDigest(entry.host_name.hash, rtype, hashBytes(address_ipv6_, 16)) : 0;
+    default:
+      return 0;
+  }
+}
+
+bool ServiceRegistry::holdsRecord(const Entry &entry, std::uint16_t rtype, std::uint64_t digest) const {
+  const FoldedName &name = (rtype == MDNS_RECORDTYPE_PTR)                                ? entry.type_name
+                           : (rtype == MDNS_RECORDTYPE_SRV || rtype == MDNS_RECORDTYPE_TXT) ? entry.instance_name
+                                                                                            : entry.host_name;
+  bool held = false;
+  forEachMatch(name, rtype, [&](const Entry &owner) { held = held || (recordDigest(owner, rtype) == digest); });
+  return held;
+}
+
+bool ServiceRegistry::writeRecord(PacketWriter &writer, PacketWriter::Section section, const Entry &entry,
+                                  std::uint16_t rtype, std::uint32_t ttl) const {
+  // The PTR record is shared with every other instance of the type, all other records are unique to this host and
+  // carry the cache-flush bit (RFC 6762 section 10.2)
+  const std::uint16_t rclass = MDNS_CLASS_IN | ((rtype == MDNS_RECORDTYPE_PTR) ? 0 : MDNS_CACHE_FLUSH);
+  const ServiceInstance &instance = entry.instance;
+  switch (rtype) {
+    case MDNS_RECORDTYPE_PTR:
+      return writer.addPtr(section, entry.type_wire, rclass, ttl, entry.instance_wire);
+    case MDNS_RECORDTYPE_SRV:
+      return writer.addSrv(section, entry.instance_wire, rclass, ttl, 0, 0, instance.port, entry.host_wire);
+    case MDNS_RECORDTYPE_TXT: {
+      if (instance.txt_record.empty() || instance.txt_record.size() > 255) {
+        return false;
+      }
+      std::uint8_t txt[256];
+      txt[0] = static_cast<std::uint8_t>(instance.txt_record.size());
+      memcpy(txt + 1, instance.txt_record.data(), instance.txt_record.size());
+      return writer.addTxt(section, entry.instance_wire, rclass, ttl, txt, instance.txt_record.size() + 1);
+    }
+    case MDNS_RECORDTYPE_A:
+      return address_ipv4_ && writer.addA(section, entry.host_wire, rclass, ttl, address_ipv4_);
+    case MDNS_RECORDTYPE_AAAA:
+      return has_ipv6_ && writer.addAaaa(section, entry.host_wire, rclass, ttl, address_ipv6_);
+    default:
+      return false;
+  }
+}
+
+const std::vector<std::uint8_t> *ServiceRegistry::answer(const Entry &entry, std::uint16_t qtype) const {
+  return entry.answers.find(qtype);
+}
+
+const std::vector<std::uint8_t> *ServiceRegistry::dnsSdAnswer(const ServiceType &type) const {
+  return type.dns_sd_answer.empty() ? nullptr : &type.dns_sd_answer;
+}
+
+void ServiceRegistry::buildAnswer(Entry &entry) {
+  entry.answers.clear();
+  MessageBuilder message;
+  PacketWriter &writer = message.writer();
+  // The question, the PTR record, and as additional records whatever of SRV, addresses and TXT fits the packet
+  message.begin(0, 0x8400);
+  if (writer.addQuestion(entry.type_wire, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN | MDNS_UNICAST_RESPONSE) &&
+      writeRecord(writer, PacketWriter::Section::Answer, entry, MDNS_RECORDTYPE_PTR, unicast_ttl)) {
+    static const std::uint16_t additional[] = {MDNS_RECORDTYPE_SRV, MDNS_RECORDTYPE_A, MDNS_RECORDTYPE_AAAA,
+                                               MDNS_RECORDTYPE_TXT};
+    for (const std::uint16_t rtype : additional) {
+      writeRecord(writer, PacketWriter::Section::Additional, entry, rtype, unicast_ttl);
+    }
+    entry.answers.store(MDNS_RECORDTYPE_PTR, message.data(0), message.size(0));
+  }
+  // The other types are answered with their own record alone
+  static const std::uint16_t single[] = {MDNS_RECORDTYPE_SRV, MDNS_RECORDTYPE_TXT, MDNS_RECORDTYPE_A,
+                                         MDNS_RECORDTYPE_AAAA};
+  for (const std::uint16_t rtype : single) {
+    const std::string &name = (rtype == MDNS_RECORDTYPE_A || rtype == MDNS_RECORDTYPE_AAAA) ? entry.host_wire
+                                                                                             : entry.instance_wire;
+    message.begin(0, 0x8400);
+    if (writer.addQuestion(name, rtype, MDNS_CLASS_IN | MDNS_UNICAST_RESPONSE) &&
+        writeRecord(writer, PacketWriter::Section::Answer, entry, rtype, unicast_ttl)) {
+      entry.answers.store(rtype, message.data(0), message.size(0));
+    }
+  }
+}
+
+bool ServiceRegistry::setNames(Entry &entry, const ServiceInstance &instance) {
+  std::string host = instance.hostname;
+  if (!host.empty() && host.back() != '.') {
+    host += '.';
+  }
+  if (!foldName(instance.name, entry.type_name) || !foldName(host + instance.name, entry.instance_name) ||
+      !foldName(host + "local.", entry.host_name)) {
+    return false;
+  }
+  entry.type_wire = wireName(instance.name);
+  entry.instance_wire = wireName(host + instance.name);
+  entry.host_wire = wireName(host + "local.");
+  return true;
+}
+
+void ServiceRegistry::indexInsert(Index &index, const FoldedName &name, const Entry *entry) {
+  index[name.hash].push_back(entry);
+}
+
+void ServiceRegistry::indexErase(Index &index, const FoldedName &name, const Entry *entry) {
+  const auto it = index.find(name.hash);
+  if (it == index.end()) {
+    return;
+  }
+  auto &entries = it->second;
+  entries.erase(std::remove(entries.begin(), entries.end(), entry), entries.end());
+  if (entries.empty()) {
+    index.erase(it);
+  }
+}
+
+void ServiceRegistry::link(const Entry *entry) {
+  indexInsert(by_type_, entry->type_name, entry);
+  indexInsert(by_instance_, entry->instance_name, entry);
+  indexInsert(by_host_, entry->host_name, entry);
+
+  auto &type = types_[entry->type_name.str()];
+  if (!type.instances++) {
+    type.name = entry->instance.name;
+    type.folded = entry->type_name;
+    MessageBuilder message;
+    message.begin(0, 0x8400);
+    PacketWriter &writer = message.writer();
+    const std::string dns_sd_wire = wireName("_services._dns-sd._udp.local.");
+    if (writer.addQuestion(dns_sd_wire, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN | MDNS_UNICAST_RESPONSE) &&
+        writer.addPtr(PacketWriter::Section::Answer, dns_sd_wire, MDNS_CLASS_IN, unicast_ttl, entry->type_wire)) {
+      type.dns_sd_answer.assign(message.data(0), message.data(0) + message.size(0));
+    }
+  }
+}
+
+void ServiceRegistry::unlink(const Entry *entry) {
+  indexErase(by_type_, entry->type_name, entry);
+  indexErase(by_instance_, entry->instance_name, entry);
+  indexErase(by_host_, entry->host_name, entry);
+
+  const auto type = types_.find(entry->type_name.str());
+  if (type != types_.end() && !--type->second.instances) {
+    types_.erase(type);
+  }
+}
+
+}  // namespace mdns_cpp
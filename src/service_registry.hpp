@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dns_name.hpp"
+#include "mdns_cpp/defs.hpp"
+#include "packet_writer.hpp"
+#include "response_cache.hpp"
+
+namespace mdns_cpp {
+
+// The set of service instances advertised by the responder.
+//
+// Every instance is reachable through three names: its service type (PTR questions), its instance name
+// <hostname>.<type> (SRV/TXT questions) and its host name <hostname>.local. (A/AAAA questions). Each name is indexed by
+// the hash of its case-folded wire format, so matching an incoming question costs one hash lookup regardless of how
+// many instances are registered. The unicast answers of an instance are serialized into its ResponseCache when it is
+// added or changed, so answering never modifies the registry.
+//
+// Entries are immutable once added: changing an instance replaces its entry, and copies of the registry share all
+// entries they have in common. A modified copy can therefore be built next to the version the service workers are
+// reading and published as a whole (see mDNS::updateRegistry).
+//
+// The registry is not synchronized. The const member functions may run concurrently with each other, everything else
+// needs exclusive access.
+class ServiceRegistry {
+ public:
+  struct Entry {
+    ServiceId id{0};
+    ServiceInstance instance;
+    FoldedName type_name;
+    FoldedName instance_name;
+    FoldedName host_name;
+    // The same names in wire format with their original case, as written into records
+    std::string type_wire;
+    std::string instance_wire;
+    std::string host_wire;
+    // Unicast answers with a query ID of 0, by question type
+    ResponseCache answers;
+  };
+
+  struct ServiceType {
+    std::string name;
+    // The PTR record answering the DNS-SD meta query points to this name
+    FoldedName folded;
+    size_t instances{0};
+    std::vector<std::uint8_t> dns_sd_answer;
+  };
+
+  // TTL of the records in multicast answers
+  static constexpr std::uint32_t multicast_ttl = 60;
+  // TTL of the records in the prebuilt unicast answers and DNS-SD answers
+  static constexpr std::uint32_t unicast_ttl = 10;
+
+  // Returns 0 if the instance names are not valid domain names
+  ServiceId add(const ServiceInstance &instance);
+  bool update(ServiceId id, const ServiceInstance &instance);
+  bool remove(ServiceId id);
+  const Entry *find(ServiceId id) const;
+  size_t size() const { return entries_.size(); }
+
+  // Sets the host addresses advertised in A/AAAA records of every instance (0 / nullptr for none)
+  void setAddresses(std::uint32_t ipv4, const std::uint8_t *ipv6);
+  std::uint32_t addressIpv4() const { return address_ipv4_; }
+  const std::uint8_t *addressIpv6() const { return has_ipv6_ ? address_ipv6_ : nullptr; }
+
+  // Calls fn(const Entry &) for every instance owning a record of type rtype (or any type for MDNS_RECORDTYPE_ANY)
+  // named name. Address records are shared by all instances on a host, so those questions match a single instance.
+  template <typename Fn>
+  void forEachMatch(const FoldedName &name, std::uint16_t rtype, Fn &&fn) const;
+
+  // Calls fn(const Entry &) for every instance
+  template <typename Fn>
+  void forEachEntry(Fn &&fn) const {
+    for (const auto &entry : entries_) fn(*entry.second);
+  }
+
+  // Calls fn(const ServiceType &) for every distinct service type, used to answer the DNS-SD meta query
+  template <typename Fn>
+  void forEachType(Fn &&fn) const {
+    for (const auto &type : types_) fn(type.second);
+  }
+
+  // Digest (see recordDigest) of the record of type rtype owned by an instance, 0 if the instance has no such record
+  std::uint64_t recordDigest(const Entry &entry, std::uint16_t rtype) const;
+  // True if an instance in the registry owns a record of type rtype with the given digest and the name the record of
+  // that type of entry has. entry itself need not be in the registry.
+  bool holdsRecord(const Entry &entry, std::uint16_t rtype, std::uint64_t digest) const;
+  // Appends the record of type rtype owned by an instance. Returns false if the instance has no such record or it does
+  // not fit the packet.
+  bool writeRecord(PacketWriter &writer, PacketWriter::Section section, const Entry &entry, std::uint16_t rtype,
+                   std::uint32_t ttl) const;
+
+  // Serialized unicast answer of an instance to a question of type qtype, with a query ID of 0. A PTR question is
+  // answered with the SRV, address and TXT records as additional records. Returns nullptr if the instance has no such
+  // record, for MDNS_RECORDTYPE_ANY, or if the answer does not fit a packet.
+  const std::vector<std::uint8_t> *answer(const Entry &entry, std::uint16_t qtype) const;
+  // Serialized answer to the DNS-SD meta query announcing a service type, nullptr if it does not fit a packet
+  const std::vector<std::uint8_t> *dnsSdAnswer(const ServiceType &type) const;
+
+ private:
+  using Index = std::unordered_map<std::uint64_t, std::vector<const Entry *>>;
+
+  static void indexInsert(Index &index, const FoldedName &name, const Entry *entry);
+  static void indexErase(Index &index, const FoldedName &name, const Entry *entry);
+  template <typename Fn>
+  static void indexFind(const Index &index, const FoldedName &name, FoldedName Entry::*key, bool first_only, Fn &fn);
+
+  bool setNames(Entry &entry, const ServiceInstance &instance);
+  void buildAnswer(Entry &entry);
+  void link(const Entry *entry);
+  void unlink(const Entry *entry);
+
+  ServiceId next_id_{1};
+  std::unordered_map<ServiceId, std::shared_ptr<const Entry>> entries_;
+  std::unordered_map<std::string, ServiceType> types_;
+  Index by_type_;
+  Index by_instance_;
+  Index by_host_;
+
+  std::uint32_t address_ipv4_{0};
+  std::uint8_t address_ipv6_[16]{0};
+  bool has_ipv6_{false};
+};
+
+template <typename Fn>
+void ServiceRegistry::indexFind(const Index &index, const FoldedName &name, FoldedName Entry::*key, bool first_only,
+                                Fn &fn) {
+  const auto it = index.find(name.hash);
+  if (it == index.end()) {
+    return;
+  }
+  for (const Entry *entry : it->second) {
+    if (entry->*key == name) {
+      fn(*entry);
+      if (first_only) {
+        return;
+      }
+    }
+  }
+}
+
+template <typename Fn>
+void ServiceRegistry::forEachMatch(const FoldedName &name, std::uint16_t rtype, Fn &&fn) const {
+  // Record types as defined in mdns.h, which is not exposed to this header
+  constexpr std::uint16_t type_a = 1, type_ptr = 12, type_txt = 16, type_aaaa = 28, type_srv = 33, type_any = 255;
+
+  if (rtype == type_ptr || rtype == type_any) {
+    indexFind(by_type_, name, &Entry::type_name, false, fn);
+  }
+  if (rtype == type_srv || rtype == type_txt || rtype == type_any) {
+    indexFind(by_instance_, name, &Entry::instance_name, false, fn);
+  }
+  if (rtype == type_a || rtype == type_aaaa || rtype == type_any) {
+    indexFind(by_host_, name, &Entry::host_name, true, fn);
+  }
+}
+
+}  // namespace mdns_cpp
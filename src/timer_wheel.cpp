@@ -0,0 +1,227 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mdns_cpp {
+
+namespace {
+
+inline std::uint32_t lowestBit(std::uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<std::uint32_t>(__builtin_ctzll(bits));
+#else
+  std::uint32_t index = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    ++index;
+  }
+  return index;
+#endif
+}
+
+}  // namespace
+
+TimerWheel::TimerWheel(Clock::time_point now) : epoch_(now) {
+  for (auto &level : levels_) {
+    std::fill(std::begin(level.heads), std::end(level.heads), none);
+    std::memset(level.occupied, 0, sizeof(level.occupied));
+  }
+}
+
+std::uint64_t TimerWheel::tickOf(Clock::time_point when) const {
+  if (when <= epoch_) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(when - epoch_).count());
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Clock::time_point when, Callback callback) {
+  const std::uint32_t index = allocate();
+  Node &node = nodes_[index];
+  node.callback = std::move(callback);
+  node.expiry = std::max(tickOf(when), current_ + 1);
+  link(index);
+  ++size_;
+  return (static_cast<std::uint64_t>(node.generation) << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  const auto index = static_cast<std::uint32_t>(id);
+  const auto generation = static_cast<std::uint32_t>(id >> 32);
+  if (index >= nodes_.size() || nodes_[index].generation != generation || nodes_[index].list == none) {
+    return false;
+  }
+  unlink(index);
+  release(index);
+  --size_;
+  return true;
+}
+
+std::uint32_t TimerWheel::allocate() {
+  if (free_ == none) {
+    nodes_.emplace_back();
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+  }
+  const std::uint32_t index = free_;
+  free_ = nodes_[index].next;
+  return index;
+}
+
+void TimerWheel::release(std::uint32_t index) {
+  Node &node = nodes_[index];
+  node.callback = nullptr;
+  // Invalidates the ids handed out for this node
+  if (!++node.generation) {
+    node.generation = 1;
+  }
+  node.list = none;
+  node.prev = none;
+  node.next = free_;
+  free_ = index;
+}
+
+void TimerWheel::link(std::uint32_t index) {
+  Node &node = nodes_[index];
+  constexpr std::uint64_t max_delta = (std::uint64_t(1) << (levels * slot_bits)) - 1;
+  if (node.expiry - current_ > max_delta) {
+    node.expiry = current_ + max_delta;
+  }
+
+  const std::uint64_t delta = node.expiry - current_;
+  int level = 0;
+  while (level < levels - 1 && delta >= (std::uint64_t(1) << ((level + 1) * slot_bits))) {
+    ++level;
+  }
+  const auto slot = static_cast<std::uint32_t>(node.expiry >> (level * slot_bits)) & slot_mask;
+
+  Level &wheel = levels_[level];
+  node.list = static_cast<std::uint32_t>(level) * slots + slot;
+  node.prev = none;
+  node.next = wheel.heads[slot];
+  if (node.next != none) {
+    nodes_[node.next].prev = index;
+  }
+  wheel.heads[slot] = index;
+  wheel.occupied[slot / 64] |= std::uint64_t(1) << (slot % 64);
+}
+
+void TimerWheel::unlink(std::uint32_t index) {
+  Node &node = nodes_[index];
+  Level &wheel = levels_[node.list / slots];
+  const std::uint32_t slot = node.list & slot_mask;
+  if (node.prev != none) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    wheel.heads[slot] = node.next;
+    if (node.next == none) {
+      wheel.occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+    }
+  }
+  if (node.next != none) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.list = none;
+}
+
+void TimerWheel::cascade(int level) {
+  const auto slot = static_cast<std::uint32_t>(current_ >> (level * slot_bits)) & slot_mask;
+  std::uint32_t index = levels_[level].heads[slot];
+  levels_[level].heads[slot] = none;
+  levels_[level].occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+  while (index != none) {
+    const std::uint32_t next = nodes_[index].next;
+    link(index);
+    index = next;
+  }
+}
+
+std::uint32_t TimerWheel::nextOccupied(const Level &level, std::uint32_t start) const {
+  for (std::uint32_t word = start / 64; word < slots / 64; ++word) {
+    std::uint64_t bits = level.occupied[word];
+    if (word == start / 64) {
+      bits &= ~std::uint64_t(0) << (start % 64);
+    }
+    if (bits) {
+      return word * 64 + lowestBit(bits);
+    }
+  }
+  return slots;
+}
+
+std::uint64_t TimerWheel::nextTick() const {
+  if (!size_) {
+    return 0;
+  }
+
+  std::uint64_t next = ~std::uint64_t(0);
+  for (int level = 0; level < levels; ++level) {
+    const int shift = level * slot_bits;
+    const std::uint64_t position = current_ >> shift;
+    const auto current_slot = static_cast<std::uint32_t>(position) & slot_mask;
+
+    // Slots after the current one come up in this rotation of the level, the others in the next one
+    std::uint64_t rotation = position & ~std::uint64_t(slot_mask);
+    std::uint32_t slot = (current_slot + 1 < slots) ? nextOccupied(levels_[level], current_slot + 1) : slots;
+    if (slot == slots) {
+      slot = nextOccupied(levels_[level], 0);
+      if (slot > current_slot) {
+        continue;
+      }
+      rotation += slots;
+    }
+    next = std::min(next, (rotation | slot) << shift);
+  }
+  return next;
+}
+
+int TimerWheel::timeout(Clock::time_point now) const {
+  const std::uint64_t tick = nextTick();
+  if (!tick) {
+    return -1;
+  }
+  const auto due = epoch_ + std::chrono::milliseconds(tick);
+  if (due <= now) {
+    return 0;
+  }
+  return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+}
+
+size_t TimerWheel::advance(Clock::time_point now) {
+  const std::uint64_t target =
+      (now <= epoch_) ? 0
+                      : static_cast<std::uint64_t>(
+                            std::chrono::duration_cast<std::chrono::milliseconds>(now - epoch_).count());
+  size_t fired = 0;
+  while (current_ < target) {
+    const std::uint64_t next = nextTick();
+    if (!next || next > target) {
+      current_ = target;
+      break;
+    }
+    current_ = next;
+
+    // Move the timers of the coarser slots starting at this tick down, a level only wraps when the one below did
+    for (int level = 1; level < levels; ++level) {
+      if (current_ & ((std::uint64_t(1) << (level * slot_bits)) - 1)) {
+        break;
+      }
+      cascade(level);
+    }
+
+    std::uint32_t &head = levels_[0].heads[current_ & slot_mask];
+    while (head != none) {
+      const std::uint32_t index = head;
+      unlink(index);
+      // The callback may schedule timers and grow the slab, so it must not run from inside a node
+      Callback callback = std::move(nodes_[index].callback);
+      release(index);
+      --size_;
+      ++fired;
+      callback();
+    }
+  }
+  return fired;
+}
+
+}  // namespace mdns_cpp
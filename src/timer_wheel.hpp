@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace mdns_cpp {
+
+// Hierarchical timer wheel with millisecond resolution.
+//
+// Four levels of 256 slots cover 2^32 ms (about 49 days); longer timers are clamped. Timers live in a slab and are
+// chained into their slot with intrusive links, so scheduling and cancelling are O(1) and no allocation happens once
+// the slab has grown to the peak number of pending timers. A timer moves to a finer level when the wheel below it
+// wraps around (at most three times in its life) and fires from level 0. Advancing skips empty stretches of the wheel,
+// so the owner can sleep until timeout() without ticking every millisecond.
+//
+// Callbacks run on the thread calling advance() and may schedule or cancel timers. The wheel is not synchronized.
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+  // Identifies a pending timer. Stays unique after the timer fired or was cancelled, 0 is never used.
+  using TimerId = std::uint64_t;
+
+  explicit TimerWheel(Clock::time_point now = Clock::now());
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  // Runs callback from the first advance() at or after when
+  TimerId schedule(Clock::time_point when, Callback callback);
+  // Returns false if the timer already fired or was cancelled
+  bool cancel(TimerId id);
+
+  size_t size() const { return size_; }
+
+  // Milliseconds until advance() may have to run a timer (0 if overdue), -1 if no timer is pending. Timers on the
+  // coarser levels are reported by the start of their slot, which can be earlier than they are due.
+  int timeout(Clock::time_point now) const;
+
+  // Runs every timer due at now, returns how many ran
+  size_t advance(Clock::time_point now);
+
+ private:
+  static constexpr int levels = 4;
+  static constexpr int slot_bits = 8;
+  static constexpr std::uint32_t slots = 1u << slot_bits;
+  static constexpr std::uint32_t slot_mask = slots - 1;
+  static constexpr std::uint32_t none = ~std::uint32_t(0);
+
+  struct Node {
+    Callback callback;
+    std::uint64_t expiry{0};
+    std::uint32_t generation{1};
+    std::uint32_t prev{none};
+    std::uint32_t next{none};
+    // Slot holding the node as level * slots + slot, none while the node is not scheduled
+    std::uint32_t list{none};
+  };
+
+  struct Level {
+    std::uint32_t heads[slots];
+    // One bit per non-empty slot
+    std::uint64_t occupied[slots / 64];
+  };
+
+  std::uint64_t tickOf(Clock::time_point when) const;
+  std::uint32_t allocate();
+  void release(std::uint32_t index);
+  void link(std::uint32_t index);
+  void unlink(std::uint32_t index);
+  void cascade(int level);
+  // Returns the first occupied slot of a level at or after slot start (without wrapping), or slots if there is none
+  std::uint32_t nextOccupied(const Level &level, std::uint32_t start) const;
+  // Earliest tick after current_ at which a timer may fire or has to move to a finer level, 0 if the wheel is empty
+  std::uint64_t nextTick() const;
+
+  Clock::time_point epoch_;
+  std::uint64_t current_{0};
+  size_t size_{0};
+  Level levels_[levels];
+  std::vector<Node> nodes_;
+  std::uint32_t free_{none};
+};
+
+}  // namespace mdns_cpp